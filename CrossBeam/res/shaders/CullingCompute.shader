@@ -0,0 +1,132 @@
+#version 430 core
+// GPU culling (see src/headers/GpuCulling.h): one invocation per object tests
+// its bounding sphere against the frustum and the Hi-Z pyramid; survivors
+// append their command and record to their group's output range. CullSphere()
+// in GpuCulling.h is the CPU reference, keep the two in step; precise keeps
+// the compiler from fusing or reordering the arithmetic the two share.
+layout(local_size_x = 64) in;
+
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+struct CullObject
+{
+	vec4 sphere; // world-space centre, w = radius
+	DrawCommand command;
+	uint group;
+	uint outputBase;
+	uint padding;
+};
+// ObjectBlock's layout, as read by the MULTI_DRAW vertex shader
+struct DrawData
+{
+	mat4 model;
+	vec4 color;
+	vec4 positionScale;
+	vec4 positionOffset;
+};
+
+layout(std140) uniform CullViewBlock
+{
+	mat4 viewProjection;
+	vec4 planes[6];
+	uvec4 params; // x, y = Hi-Z size, z = Hi-Z levels (0 = frustum only), w = object count
+} uView;
+
+layout(std430) readonly buffer CullObjectBlock
+{
+	CullObject objects[];
+};
+layout(std430) readonly buffer CullRecordBlock
+{
+	DrawData records[];
+};
+layout(std430) writeonly buffer CullCommandBlock
+{
+	DrawCommand commands[];
+};
+layout(std430) writeonly buffer CullVisibleRecordBlock
+{
+	DrawData visibleRecords[];
+};
+layout(std430) buffer CullCounterBlock
+{
+	uint counters[];
+};
+layout(std430) writeonly buffer CullVisibilityBlock
+{
+	uint visibility[];
+};
+
+layout(binding = 0) uniform sampler2D uHiZ;
+
+bool occluded(vec3 center, float radius)
+{
+	// screen rectangle and nearest depth of the sphere's bounding box
+	vec2 minUV = vec2(1.0), maxUV = vec2(0.0);
+	float nearest = 1.0;
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = center + vec3((i & 1) != 0 ? radius : -radius, (i & 2) != 0 ? radius : -radius, (i & 4) != 0 ? radius : -radius);
+		precise vec4 clip = uView.viewProjection * vec4(corner, 1.0);
+		// reaches behind the camera, the projection is meaningless
+		if (clip.w <= 0.0)
+			return false;
+		precise vec3 ndc = clip.xyz / clip.w;
+		minUV = min(minUV, ndc.xy * 0.5 + 0.5);
+		maxUV = max(maxUV, ndc.xy * 0.5 + 0.5);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+	ivec2 size = ivec2(uView.params.xy);
+	ivec2 low = clamp(ivec2(floor(clamp(minUV, 0.0, 1.0) * vec2(size))), ivec2(0), size - 1);
+	ivec2 high = clamp(ivec2(floor(clamp(maxUV, 0.0, 1.0) * vec2(size))), ivec2(0), size - 1);
+
+	// finest level at which the rectangle spans at most 2x2 texels
+	int levels = int(uView.params.z);
+	int level = 0;
+	ivec2 first, last;
+	for (;; ++level)
+	{
+		ivec2 levelSize = max(size >> level, ivec2(1));
+		first = min(low >> level, levelSize - 1);
+		last = min(high >> level, levelSize - 1);
+		if (all(lessThanEqual(last - first, ivec2(1))) || level == levels - 1)
+			break;
+	}
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x)
+			farthest = max(farthest, texelFetch(uHiZ, ivec2(x, y), level).r);
+	return nearest > farthest;
+}
+
+bool visible(vec4 sphere)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		precise float distance = dot(uView.planes[i].xyz, sphere.xyz) + uView.planes[i].w;
+		if (distance < -sphere.w)
+			return false;
+	}
+	return uView.params.z == 0u || !occluded(sphere.xyz, sphere.w);
+}
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= uView.params.w)
+		return;
+	CullObject object = objects[index];
+	bool keep = visible(object.sphere);
+	visibility[index] = keep ? 1u : 0u;
+	if (!keep)
+		return;
+	uint slot = object.outputBase + atomicAdd(counters[object.group], 1u);
+	commands[slot] = object.command;
+	visibleRecords[slot] = records[index];
+}
\ No newline at end of file
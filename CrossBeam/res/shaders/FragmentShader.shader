@@ -2,8 +2,24 @@
 out vec4 FragColor;
 
 in vec3 ourColor;
+#ifdef VERTEX_NORMAL
+in vec3 ourNormal;
+#endif
+
+#include "include/UniformBlocks.glsl"
 
 void main()
 {
-	FragColor = vec4(ourColor, 1.0);
+#ifdef WIREFRAME
+	// lines only need a flat, bright color
+	FragColor = vec4(1.0);
+#else
+	vec3 color = ourColor;
+#ifdef VERTEX_NORMAL
+	// headlight: surfaces facing the camera are lit
+	vec3 normal = normalize(mat3(uFrame.view) * ourNormal);
+	color *= 0.35 + 0.65 * max(normal.z, 0.0);
+#endif
+	FragColor = vec4(color, 1.0) * uMaterial.baseColor;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 430 core
+// One Hi-Z level per dispatch (see src/headers/HiZPyramid.h): level 0 copies
+// the depth texture, every further level keeps the farthest depth of the 2x2
+// texels below it, 3 wide/tall at the last column/row of an odd-sized level.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D uDepth;
+layout(binding = 0, r32f) readonly uniform image2D uPrevious;
+layout(binding = 1, r32f) writeonly uniform image2D uCurrent;
+uniform int uLevel;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(uCurrent);
+	if (any(greaterThanEqual(texel, size)))
+		return;
+	if (uLevel == 0)
+	{
+		imageStore(uCurrent, texel, vec4(texelFetch(uDepth, texel, 0).r));
+		return;
+	}
+
+	ivec2 previousSize = imageSize(uPrevious);
+	ivec2 first = texel * 2;
+	ivec2 last = min(first + 1, previousSize - 1);
+	if (texel.x == size.x - 1)
+		last.x = previousSize.x - 1;
+	if (texel.y == size.y - 1)
+		last.y = previousSize.y - 1;
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x)
+			farthest = max(farthest, imageLoad(uPrevious, ivec2(x, y)).r);
+	imageStore(uCurrent, texel, vec4(farthest));
+}
\ No newline at end of file
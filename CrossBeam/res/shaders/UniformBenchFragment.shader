@@ -0,0 +1,9 @@
+#version 400 core
+out vec4 FragColor;
+
+in float weight;
+
+void main()
+{
+	FragColor = vec4(vec3(weight), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 400 core
+layout(location = 0) in vec3 aPos;
+
+uniform float uWeights[16];
+
+out float weight;
+
+void main()
+{
+	float sum = 0.0;
+	for (int i = 0; i < 16; ++i)
+		sum += uWeights[i];
+	gl_Position = vec4(aPos, 1.0);
+	weight = sum;
+}
\ No newline at end of file
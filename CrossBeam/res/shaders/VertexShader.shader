@@ -1,11 +1,84 @@
 #version 400 core
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+// Attributes may be packed (snorm16/half positions, unorm8 colors,
+// 2_10_10_10 normals and tangents, half uvs); the vertex fetch hands them
+// over as floats, only positions still need the mesh's dequantization.
 layout(location = 0) in vec3 aPos;
+#ifdef VERTEX_COLOR
 layout(location = 1) in vec3 aColor;
+#endif
+#ifdef VERTEX_NORMAL
+layout(location = 2) in vec3 aNormal;
+#endif
+#ifdef VERTEX_TANGENT
+layout(location = 3) in vec4 aTangent;
+#endif
+#ifdef VERTEX_TEXCOORD
+layout(location = 4) in vec2 aTexCoord;
+#endif
+#ifdef INSTANCING
+// per instance (divisor 1), see InstanceBatcher
+layout(location = 8) in mat4 aInstanceModel;
+layout(location = 12) in vec4 aInstanceColor;
+#endif
+
+#include "include/UniformBlocks.glsl"
+
+#ifdef MULTI_DRAW
+// one record per command of the multi-draw call (ObjectBlock's layout)
+struct DrawData
+{
+	mat4 model;
+	vec4 color;
+	vec4 positionScale;
+	vec4 positionOffset;
+};
+layout(std430) readonly buffer DrawBlock
+{
+	DrawData draws[];
+} uDraws;
+#define OBJECT uDraws.draws[gl_DrawIDARB]
+#else
+#define OBJECT uObject
+#endif
 
 out vec3 ourColor;
+#ifdef VERTEX_NORMAL
+out vec3 ourNormal;
+#endif
+#ifdef VERTEX_TANGENT
+out vec4 ourTangent;
+#endif
+#ifdef VERTEX_TEXCOORD
+out vec2 ourTexCoord;
+#endif
 
 void main()
 {
-	gl_Position = vec4(aPos, 1.0);
-	ourColor = aColor;
+	vec3 position = aPos * OBJECT.positionScale.xyz + OBJECT.positionOffset.xyz;
+	mat4 model = OBJECT.model;
+	vec3 color = OBJECT.color.rgb;
+#ifdef INSTANCING
+	model = model * aInstanceModel;
+	color *= aInstanceColor.rgb;
+#endif
+	gl_Position = uFrame.viewProjection * model * vec4(position, 1.0);
+#ifdef VERTEX_COLOR
+	ourColor = aColor * color;
+#else
+	ourColor = color;
+#endif
+	// 10-bit normals and tangents are not quite unit length once decoded
+#ifdef VERTEX_NORMAL
+	ourNormal = normalize(mat3(model) * aNormal);
+#endif
+#ifdef VERTEX_TANGENT
+	ourTangent = vec4(normalize(mat3(model) * aTangent.xyz), aTangent.w < 0.0 ? -1.0 : 1.0);
+#endif
+#ifdef VERTEX_TEXCOORD
+	ourTexCoord = aTexCoord;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+// Uniform blocks shared by every program. Must match the std140 structs in
+// src/headers/UniformBuffer.h; binding points are assigned by name on link.
+
+// per-frame: uploaded once per frame
+layout(std140) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 time; // x = seconds, y = delta, z = frame index
+} uFrame;
+
+// per-material: changes when the material does
+layout(std140) uniform MaterialBlock
+{
+	vec4 baseColor;
+	vec4 params;
+} uMaterial;
+
+// per-object: a range of the per-draw ring buffer
+layout(std140) uniform ObjectBlock
+{
+	mat4 model;
+	vec4 color;
+	vec4 positionScale; // packed positions: aPos * scale + offset
+	vec4 positionOffset;
+} uObject;
@@ -2,12 +2,38 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <chrono>
 #include "headers/BasicShader.h"
+#include "headers/ShaderCompiler.h"
+#include "headers/ShaderWatcher.h"
+#include "headers/ShaderVariants.h"
+#include "headers/UniformBuffer.h"
+#include "headers/GLStateCache.h"
+#include "headers/VertexLayout.h"
+#include "headers/VertexPacking.h"
+#include "headers/GeometryPool.h"
+#include "headers/MultiDraw.h"
+#include "headers/RenderQueue.h"
+#include "headers/FiberScheduler.h"
+#include "headers/HeadlessContext.h"
+#include "headers/RenderTarget.h"
+#include "headers/FrameStats.h"
+#include "headers/FramePacer.h"
+#include "headers/InputSystem.h"
+#include "headers/Profiler.h"
+#include "headers/GpuProfiler.h"
+#include "headers/Benchmarks.h"
 
 using namespace std;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void ProcessInput(GLFWwindow* window);
+void ProcessInput(GLFWwindow* window, const InputSystem& input);
+void RunRenderLoop(GLFWwindow* window, const FramePacer::Settings& pacing, const RenderTarget* target = NULL, unsigned int maxFrames = 0);
 
 // Settings:
 const unsigned int SCR_WIDTH = 1024;
@@ -16,42 +42,154 @@ const unsigned int SCR_HEIGHT = 768;
 // Bools:
 bool isWireFrameOn = false;
 
+// Input actions (bound in RunRenderLoop):
+enum InputAction
+{
+	ACTION_QUIT,
+	ACTION_TOGGLE_WIREFRAME
+};
+
 #pragma region MAIN
-int main(void)
+int main(int argc, char** argv)
 {
+	// Headless Mode: "--headless [--frames N] [--size WxH]" anywhere on the command line
+	// renders into an offscreen target without a window; the other arguments work as usual:
+	bool headless = false;
+	unsigned int headlessFrames = 300;
+	unsigned int targetWidth = SCR_WIDTH, targetHeight = SCR_HEIGHT;
+	// "--trace FILE" writes the render loop's profiler zones as Chrome trace JSON:
+	const char* tracePath = NULL;
+	// Frame pacing: "--vsync off|on|adaptive", "--fps N" (frame cap), "--frames-in-flight N":
+	FramePacer::Settings pacing;
+	int keptArgs = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			headlessFrames = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--vsync") == 0 && i + 1 < argc)
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "off") == 0)
+				pacing.swapMode = SWAP_IMMEDIATE;
+			else if (strcmp(mode, "on") == 0)
+				pacing.swapMode = SWAP_VSYNC;
+			else if (strcmp(mode, "adaptive") == 0)
+				pacing.swapMode = SWAP_ADAPTIVE;
+			else
+			{
+				cout << "ERROR::PACING::BAD_VSYNC " << mode << " (expected off, on or adaptive)" << endl;
+				return -1;
+			}
+		}
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			pacing.targetFps = atof(argv[++i]);
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+		{
+			int frames = atoi(argv[++i]);
+			if (frames < 1)
+			{
+				cout << "ERROR::PACING::BAD_FRAMES_IN_FLIGHT " << argv[i] << " (expected 1 or more)" << endl;
+				return -1;
+			}
+			pacing.maxFramesInFlight = (unsigned int)frames;
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%ux%u", &targetWidth, &targetHeight) != 2 || targetWidth == 0 || targetHeight == 0)
+			{
+				cout << "ERROR::HEADLESS::BAD_SIZE " << argv[i] << " (expected WxH)" << endl;
+				return -1;
+			}
+		}
+		else
+			argv[keptArgs++] = argv[i];
+	}
+	argc = keptArgs;
+	// headless images must not depend on how fast the host is
+	pacing.lockstep = headless;
+
+	// CPU-only Benchmark Mode (no window needed):
+	if (argc > 1 && strcmp(argv[1], "--bench-mesh-optimizer") == 0)
+	{
+		RunMeshOptimizerBenchmark();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-fibers") == 0)
+	{
+		RunFiberBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 1000000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--verify-fibers") == 0)
+	{
+		return VerifyFiberScheduler() ? 0 : 1;
+	}
+	if (argc > 1 && strcmp(argv[1], "--verify-input") == 0)
+	{
+		return VerifyInputSystem() ? 0 : 1;
+	}
+	if (argc > 1 && strcmp(argv[1], "--verify-command-lists") == 0)
+	{
+		return VerifyCommandRecorder(argc > 2 ? (unsigned int)atoi(argv[2]) : 20000) ? 0 : 1;
+	}
+#ifndef CROSSBEAM_SHIPPING
+	if (argc > 1 && strcmp(argv[1], "--bench-profiler") == 0)
+	{
+		RunProfilerBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 10000000);
+		return 0;
+	}
+#endif
 
+	// declared before every GL object so it is destroyed after them
+	HeadlessContext headlessContext;
+	GLFWwindow* window = NULL;
+	if (headless)
+	{
+		if (!headlessContext.create())
+		{
+			cout << "Failed to create a headless OpenGL context!" << endl;
+			return -1;
+		}
+		cout << "Headless context: " << headlessContext.getDescription() << endl;
+	}
+	else
+	{
 #pragma region GLFW INIT
-	/* GLFW: CONFIGURE & INITIALIZE */
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		/* GLFW: CONFIGURE & INITIALIZE */
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 #pragma endregion
 
 #pragma region GLFW WINDOW CREATION
-	/* GLFW: WINDOW CREATION */
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CrossBeam", NULL, NULL);
-	if (window == NULL)
-	{
-		cout << "Failed to create GLFW window!" << endl;
-		glfwTerminate();
-		return -1;
-	}
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		/* GLFW: WINDOW CREATION */
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CrossBeam", NULL, NULL);
+		if (window == NULL)
+		{
+			cout << "Failed to create GLFW window!" << endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-	// OPENGL Viewport:
-	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+		// OPENGL Viewport:
+		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 #pragma endregion	
+	}
 
 #pragma region GLEW INIT
 	/* GLEW: LOAD ALL OPENGL FUNCTION POINTERS */
 	int glewErr = glewInit();
-	if (GLEW_OK != glewErr)
+	if (GLEW_OK != glewErr && !headlessContext.acceptsGlewError(glewErr))
 	{
 		/* Problem: glewInit failed, something is seriously wrong! */
 		fprintf(stderr, "ERROR: %s\n", glewGetErrorString(glewErr));
@@ -61,112 +199,319 @@ int main(void)
 	// Print Current OGL Version:
 	cout << "OpenGL Version: " << glGetString(GL_VERSION) << endl;
 
+	// Headless runs (benchmarks included) draw into an offscreen target:
+	unique_ptr<RenderTarget> renderTarget;
+	if (headless)
+	{
+		renderTarget.reset(new RenderTarget(targetWidth, targetHeight));
+		renderTarget->bind();
+		cout << "Render target: " << targetWidth << "x" << targetHeight << ", " << headlessFrames << " frames" << endl;
+	}
+
+	// Benchmark Mode:
+	if (argc > 1 && strcmp(argv[1], "--bench-uniforms") == 0)
+	{
+		RunUniformBenchmark();
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-multi-draw") == 0)
+	{
+		RunMultiDrawBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 100000);
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-instancing") == 0)
+	{
+		RunInstancingBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 100000);
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-render-queue") == 0)
+	{
+		RunRenderQueueBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 50000);
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-jobs") == 0)
+	{
+		RunJobSystemBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 1000000);
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-command-lists") == 0)
+	{
+		RunCommandListBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 20000);
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-culling") == 0)
+	{
+		RunCullingBenchmark(argc > 2 ? (unsigned int)atoi(argv[2]) : 100000);
+		glfwTerminate();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-shader-cache") == 0)
+	{
+		RunShaderCacheBenchmark(argc > 2 ? atoi(argv[2]) : 200);
+		glfwTerminate();
+		return 0;
+	}
+	// Self-check Mode (exit code 1 on failure):
+	if (argc > 1 && strcmp(argv[1], "--verify-state-cache") == 0)
+	{
+		bool passed = VerifyGLStateCache();
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+	if (argc > 1 && strcmp(argv[1], "--verify-culling") == 0)
+	{
+		bool passed = VerifyGpuCulling(argc > 2 ? (unsigned int)atoi(argv[2]) : 20000);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+
+	// Scene and render loop (GL objects are released when it returns):
+	if (tracePath)
+		PROFILE_BEGIN_CAPTURE();
+	RunRenderLoop(window, pacing, renderTarget.get(), headlessFrames);
+	if (tracePath)
+		PROFILE_WRITE_TRACE(tracePath);
+
+	glfwTerminate();
+	return 0;
+}
+#pragma endregion
+
+#pragma region RENDER LOOP
+void RunRenderLoop(GLFWwindow* window, const FramePacer::Settings& pacing, const RenderTarget* target, unsigned int maxFrames)
+{
 #pragma region TRIANGLE CREATION
 	// Vertices for Triangle!
-	float vertices[] = {
-		// positions #####		// colors ######
-		-0.5f, -0.5f, 0.0f,		1.0f, 0.0f, 0.0f,	// top right
-		 0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,	// bottom right
-		 0.0f,  0.5f, 0.0f,		0.0f, 0.0f, 1.0f	// top left
+	vector<SourceVertex> vertices = {
+		//				positions #####				// colors ######
+		SourceVertex(Vec3(-0.5f, -0.5f, 0.0f),	Vec4(1.0f, 0.0f, 0.0f, 1.0f)),	// bottom left
+		SourceVertex(Vec3( 0.5f, -0.5f, 0.0f),	Vec4(0.0f, 1.0f, 0.0f, 1.0f)),	// bottom right
+		SourceVertex(Vec3( 0.0f,  0.5f, 0.0f),	Vec4(0.0f, 0.0f, 1.0f, 1.0f))	// top
 	};
+	vector<uint32_t> indices = { 0, 1, 2 };
 
-	// Creating Vertex Buffer Objects:
-	unsigned int VBO;
-	glGenBuffers(1, &VBO);
+	/* PACK VERTEX DATA: snorm16 position + unorm8 color, 12 bytes instead of 24 */
+	PackedVertexFormat format;
+	format.position = POSITION_SNORM16;
+	format.color = true;
+	QuantizationBounds bounds;
+	vector<unsigned char> packedVertices;
 
-	// Binding the VBO to the Array buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	// Scene setup runs as fiber tasks next to the first frames: the setup task
+	// parks while the vertices are measured, then packs them. The frame loop
+	// polls the scheduler and uploads the mesh once setup is done (GL stays on
+	// this thread). The counter is declared first so it outlives the workers,
+	// which ~FiberScheduler joins:
+	FiberCounter sceneLoaded;
+	FiberScheduler fibers;
+	fibers.run([&]()
+	{
+		FiberCounter measured;
+		fibers.run([&]() { bounds = QuantizationBounds::fromVertices(vertices); }, &measured);
+		fibers.wait(measured);
+		packedVertices = VertexPacker(format, bounds).pack(vertices);
+	}, &sceneLoaded);
 
-	// Copy Vertex Data into Memory:
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// Static meshes share the pool's buffers and one VAO per vertex format:
+	GeometryPool geometry;
+	GeometryHandle triangle;
+#pragma endregion
 
-	/* INTERPRET VERTEX DATA */
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+	// Generate Shaders (compiled in the background, a placeholder draws until they are ready):
+	ShaderCompiler shaderCompiler;
+	ShaderVariants basicShaders(shaderCompiler, "res/shaders/VertexShader.shader", "res/shaders/FragmentShader.shader");
+	basicShaders.prewarm("res/shaders/BasicShader.variants");
+	// Recompile shaders whenever their files are saved:
+	ShaderWatcher shaderWatcher("res/shaders");
 
-	/* GENERATE VAO */
-	unsigned int VAO;
-	glGenVertexArrays(1, &VAO);
-#pragma endregion
+	// Uniform Blocks (see res/shaders/include/UniformBlocks.glsl):
+	// per-frame and per-draw data stream through fenced rings, nothing is respecified while the GPU reads it
+	UniformRing frameUniforms(UNIFORM_BINDING_FRAME, 4 * 1024);
+	UniformBuffer<MaterialBlock> materialUniforms(UNIFORM_BINDING_MATERIAL);
+	UniformRing objectUniforms(UNIFORM_BINDING_OBJECT, 64 * 1024);
+	// Draws are recorded into a sort-key queue and replayed in state order; each run
+	// of equal state becomes one multi-draw indirect call where supported:
+	RenderQueue renderQueue(geometry);
+	MultiDrawBatch drawBatch(geometry, 1024);
+	bool multiDraw = MultiDrawBatch::isSupported();
+	MaterialBlock defaultMaterial;
+	defaultMaterial.baseColor = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	materialUniforms.update(defaultMaterial);
+	// Frames are paced (frames in flight, optional cap, swap interval) and the scene
+	// simulates in fixed steps; frame times come from the pacer's steady clock:
+	FramePacer pacer(pacing);
+	if (window)
+		pacer.applySwapMode();
+	unsigned int frameIndex = 0;
+	FrameStats frameStats;
+	// Input arrives through GLFW callbacks and is applied once per frame:
+	InputSystem input;
+	if (window)
+		input.attach(window);
+	input.bindAction(ACTION_QUIT, GLFW_KEY_ESCAPE);
+	input.bindAction(ACTION_TOGGLE_WIREFRAME, GLFW_KEY_F);
+	// the triangle sways; rendered between the last two simulation steps
+	double simulationTime = 0.0;
+	float sway = 0.0f, previousSway = 0.0f;
+	// GPU time of the passes, read back a few frames late into the profiler
+	GpuProfiler gpuProfiler;
 
-	// Generate Shaders:
-	Shader ourShader("res/shaders/VertexShader.shader", "res/shaders/FragmentShader.shader");
-
-#pragma region TRIANGLE INIT
-	// Initialization code:
-	// Bind VAO:
-	glBindVertexArray(VAO);
-	// copy vertices array in a buffer for OpenGL to use:
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// set vertex attribute pointers:
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// set color attribute pointers:
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-#pragma endregion
+	GLStateCache& glState = GLStateCache::instance();
 
-	/* RENDER LOOP */
-	while (!glfwWindowShouldClose(window))
+	/* RENDER LOOP (headless: a fixed number of frames) */
+	while (window ? !glfwWindowShouldClose(window) : frameIndex < maxFrames)
 	{
-		// Calls input processor:
-		ProcessInput(window);
+		// Profiler zones: the previous frame is collected before this one opens
+		// (GPU results first, so they land in the same summary)
+		GPU_PROFILE_FRAME(gpuProfiler);
+		PROFILE_FRAME();
+		PROFILE_SCOPE("Frame");
+
+		// Wait for a frame slot and the frame cap before sampling input, so the
+		// frame is built from the freshest input:
+		{
+			PROFILE_SCOPE("Pacing");
+			pacer.beginFrame();
+		}
+
+		// Checks for triggered events (keyboard, mouse movements, etc.) and calls input processor:
+		if (window)
+		{
+			PROFILE_SCOPE("Input");
+			glfwPollEvents();
+			input.update();
+			ProcessInput(window, input);
+		}
+
+		// Fixed-step simulation:
+		for (unsigned int step = 0; step < pacer.getSteps(); ++step)
+		{
+			previousSway = sway;
+			simulationTime += pacer.getFixedStep();
+			sway = 0.25f * (float)sin(simulationTime * 1.5);
+		}
+
+		// Let scene tasks run without waiting on them, upload what they finished:
+		{
+			PROFILE_SCOPE("Scene tasks");
+			fibers.poll();
+			if (!triangle.valid() && sceneLoaded.isDone())
+			{
+				VertexPacker packer(format, bounds);
+				triangle = geometry.add(packer.getLayout(), packedVertices.data(), (unsigned int)vertices.size(),
+					indices, GL_TRIANGLES, packer.getBounds());
+			}
+		}
+
+		// Queue edited shaders and swap in any that finished compiling:
+		{
+			PROFILE_SCOPE("Shader reload");
+			vector<string> changedShaders = shaderWatcher.takeChanges();
+			shaderCompiler.reload(changedShaders);
+			basicShaders.reload(changedShaders);
+			shaderCompiler.poll();
+		}
+
+		// Per-frame uniforms, uploaded once for every program:
+		if (frameIndex > 0)
+			frameStats.add(pacer.getDelta() * 1000.0);
+		FrameBlock frame;
+		frame.view = Mat4::identity();
+		frame.projection = Mat4::identity();
+		frame.viewProjection = frame.projection * frame.view;
+		frame.time = Vec4((float)pacer.getTime(), (float)pacer.getDelta(), (float)frameIndex++, 0.0f);
+		frameUniforms.beginFrame();
+		frameUniforms.pushAndBind(frame);
+		objectUniforms.beginFrame();
 
 		// render
 		// clear the color buffer
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		{
+			GPU_PROFILE_SCOPE(gpuProfiler, "Clear");
+			glState.clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
 
-		// activate shader
-		ourShader.use();
+		// pick the shader (the wireframe variant draws flat lines)
+		uint64_t shaderFeatures = SHADER_FEATURE_VERTEX_COLOR | (isWireFrameOn ? SHADER_FEATURE_WIREFRAME : 0);
+		if (multiDraw)
+			shaderFeatures |= SHADER_FEATURE_MULTI_DRAW;
+		Shader& shader = basicShaders.get(shaderFeatures);
 
-		// render the rectangle
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, 3);
+		// record the frame's draws; per-object data is one record per draw,
+		// read through gl_DrawID (or the object block)
+		{
+			PROFILE_SCOPE("Record draws");
+			renderQueue.begin();
+			ObjectBlock object;
+			float renderedSway = previousSway + (sway - previousSway) * (float)pacer.getAlpha();
+			object.model = Mat4::translation(Vec3(renderedSway, 0.0f, 0.0f));
+			object.color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+			if (triangle.valid())
+				renderQueue.add(RENDER_PASS_MAIN, shader, 0, triangle, object, RenderQueue::viewDistance(frame.viewProjection, Vec3(0.0f, 0.0f, 0.0f)));
+		}
 
-		// Swaps the color buffer (contains color values for each pixel in GLFW Window
-		glfwSwapBuffers(window);
-		// Checks for triggered events (keyboard, mouse movements, etc.)
-		glfwPollEvents();
+		// sort and render the triangle (the queue binds the programs)
+		{
+			PROFILE_SCOPE("Submit");
+			GPU_PROFILE_SCOPE(gpuProfiler, "Main pass");
+			drawBatch.begin();
+			renderQueue.submit(objectUniforms, nullptr, multiDraw ? &drawBatch : nullptr);
+			// fence this frame's streamed data
+			drawBatch.end();
+			frameUniforms.endFrame();
+			objectUniforms.endFrame();
+		}
 
+		PROFILE_SCOPE("Present");
+		if (window)
+		{
+			// Swaps the color buffer (contains color values for each pixel in GLFW Window
+			glfwSwapBuffers(window);
+		}
+		else
+		{
+			// no display paces a headless frame, wait for the GPU so frame times include its work
+			glFinish();
+		}
+		pacer.endFrame();
 	}
 
-	glfwTerminate();
-	return 0;
+	// Frame time summary (headless runs also report the final image for comparisons):
+	GPU_PROFILE_FRAME(gpuProfiler);
+	PROFILE_FRAME();
+	frameStats.print(window ? "Frames" : "Headless frames");
+	cout << "Frame pacing: " << pacer.getFenceWaits() << " frames waited on the GPU (" << pacer.getFenceWaitMs() << " ms), "
+		<< pacing.maxFramesInFlight << " in flight" << endl;
+	PROFILE_PRINT_SUMMARY();
+	if (target)
+		cout << "Image checksum: " << hex << target->checksum() << dec << endl;
+
+	// Redundant state filtering summary:
+	const GLStateCache::Counters& stateCounters = glState.counters();
+	cout << "GL state calls: " << stateCounters.issued << " issued, " << stateCounters.filtered << " filtered" << endl;
 }
 #pragma endregion
 
-// Process GLFW Input:
-/* TODO:	WIREFRAME MODE */
-void ProcessInput(GLFWwindow* window)
+// Process GLFW Input (edges fire once per press, however long the key is held):
+void ProcessInput(GLFWwindow* window, const InputSystem& input)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if (input.actionPressed(ACTION_QUIT))
 	{
 		glfwSetWindowShouldClose(window, true);
 	}
 
-	/* WIREFRAME TOGGLE (WORK IN PROGRESS) */
-	if (isWireFrameOn) 
-	{
-		if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
-		{
-			isWireFrameOn = false;
-			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		}
-	}
-	else if (!isWireFrameOn)
+	/* WIREFRAME TOGGLE */
+	if (input.actionPressed(ACTION_TOGGLE_WIREFRAME))
 	{
-		if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
-		{
-			isWireFrameOn = true;
-			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		}
+		isWireFrameOn = !isWireFrameOn;
+		GLStateCache::instance().polygonMode(isWireFrameOn ? GL_LINE : GL_FILL);
 	}
 }
 
@@ -6,97 +6,383 @@
 #include <GL/glew.h>
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
+#include <chrono>
 #include <iostream>
 
+#include "Hash.h"
+#include "ShaderSource.h"
+#include "GLStateCache.h"
+#include "UniformBuffer.h"
+#include "ProgramBinaryCache.h"
+
+// pre-resolved uniform: an index into the owning shader's uniform table
+// ------------------------------------------------------------------------
+struct UniformHandle
+{
+    int slot = -1;
+    bool valid() const { return slot >= 0; }
+};
+
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
-    // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
-    {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
+    // constructor generates the shader on the fly. Defines are inserted after
+    // the #version line of both stages.
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "")
+    {
+        // 1. map the vertex/fragment files and resolve their #includes
+        ShaderSourceLoader& loader = ShaderSourceLoader::instance();
+        ShaderSource vertexSource, fragmentSource;
+        loader.load(vertexPath, defines, vertexSource);
+        loader.load(fragmentPath, defines, fragmentSource);
+        build(vertexSource, fragmentSource);
+    }
+    // build from in-memory sources
+    // ------------------------------------------------------------------------
+    static Shader fromSource(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines = "")
+    {
+        Shader shader;
+        shader.build(ShaderSource::fromString(vertexCode, defines), ShaderSource::fromString(fragmentCode, defines));
+        return shader;
+    }
+    // compute program (GL 4.3 / ARB_compute_shader); defines go after #version
+    // ------------------------------------------------------------------------
+    static Shader compute(const char* computePath, const std::string& defines = "")
+    {
+        ShaderSource computeSource;
+        ShaderSourceLoader::instance().load(computePath, defines, computeSource);
+        Shader shader;
+        shader.buildCompute(computeSource);
+        return shader;
+    }
+    // false while an asynchronous build is still in flight; ID then refers to
+    // the ShaderCompiler's placeholder program
+    // ------------------------------------------------------------------------
+    bool isReady() const
+    {
+        return ready;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use()
+    {
+        GLStateCache::instance().useProgram(ID);
+    }
+    // resolve a uniform once; the handle stays valid for the lifetime of the shader
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const char* name)
+    {
+        UniformHandle handle;
+        handle.slot = findOrAddSlot(name, HashString(name));
+        return handle;
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(locationOf(handle), (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(locationOf(handle), value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(locationOf(handle), value);
+    }
+    // by-name variants go through the cached table instead of glGetUniformLocation
+    // ------------------------------------------------------------------------
+    void setBool(const char* name, bool value) const
+    {
+        glUniform1i(findLocation(name), (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const char* name, int value) const
+    {
+        glUniform1i(findLocation(name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const char* name, float value) const
+    {
+        glUniform1f(findLocation(name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setBool(const std::string& name, bool value) const { setBool(name.c_str(), value); }
+    void setInt(const std::string& name, int value) const { setInt(name.c_str(), value); }
+    void setFloat(const std::string& name, float value) const { setFloat(name.c_str(), value); }
+
+private:
+    friend class ShaderCompiler;
+
+    bool ready = true;
+
+    Shader() : ID(0) {}
+
+    // take ownership of a linked program, releasing the one it replaces
+    // ------------------------------------------------------------------------
+    void adoptProgram(unsigned int program)
+    {
+        if (ready && ID != 0)
+        {
+            GLStateCache::instance().forgetProgram(ID);
+            glDeleteProgram(ID);
+        }
+        ID = program;
+        ready = true;
+        reflectUniforms();
+        bindUniformBlocks();
+    }
+
+    // 2. load the program from the binary cache, or compile, link and store it
+    // ------------------------------------------------------------------------
+    void build(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+        uint64_t key = cache.makeKey(vertexSource.hash, fragmentSource.hash);
+
+        ID = glCreateProgram();
+        bool cached = cache.load(ID, key);
+        if (!cached)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            // a rejected binary leaves the program in an undefined state, start over
+            glDeleteProgram(ID);
+            unsigned int shaders[2];
+            ID = startProgram(vertexSource, fragmentSource, shaders);
+            if (finishProgram(ID, shaders))
+                cache.store(ID, key);
         }
-        catch (std::ifstream::failure& e)
+        // cache every active uniform location so draws never query the driver
+        reflectUniforms();
+        bindUniformBlocks();
+
+        ProgramBinaryCache::Stats& stats = cache.stats();
+        stats.programs++;
+        (cached ? stats.hits : stats.misses)++;
+        stats.totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    // single-stage variant of build(); the key pairs the stage hash with 0,
+    // which no vertex/fragment pair produces in practice
+    // ------------------------------------------------------------------------
+    void buildCompute(const ShaderSource& computeSource)
+    {
+        ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+        uint64_t key = cache.makeKey(computeSource.hash, 0);
+
+        ID = glCreateProgram();
+        bool cached = cache.load(ID, key);
+        if (!cached)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            glDeleteProgram(ID);
+            unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(shader, (GLsizei)computeSource.strings.size(), computeSource.strings.data(), computeSource.lengths.data());
+            glCompileShader(shader);
+            ID = glCreateProgram();
+            glAttachShader(ID, shader);
+            if (cache.enabled())
+                glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glLinkProgram(ID);
+            int success = 0;
+            glGetProgramiv(ID, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                checkCompileErrors(shader, "COMPUTE");
+                checkCompileErrors(ID, "PROGRAM");
+            }
+            glDetachShader(ID, shader);
+            glDeleteShader(shader);
+            if (success)
+                cache.store(ID, key);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        reflectUniforms();
+        bindUniformBlocks();
+    }
+    // queue compilation of both stages and the link without checking any
+    // status in between, so the driver is free to overlap (or parallelize) them.
+    // The sources go to the driver as string lists, nothing is concatenated.
+    // ------------------------------------------------------------------------
+    static unsigned int startProgram(const ShaderSource& vertexSource, const ShaderSource& fragmentSource, unsigned int shaders[2])
+    {
         // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        shaders[0] = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(shaders[0], (GLsizei)vertexSource.strings.size(), vertexSource.strings.data(), vertexSource.lengths.data());
+        glCompileShader(shaders[0]);
         // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        shaders[1] = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(shaders[1], (GLsizei)fragmentSource.strings.size(), fragmentSource.strings.data(), fragmentSource.lengths.data());
+        glCompileShader(shaders[1]);
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, shaders[0]);
+        glAttachShader(program, shaders[1]);
+        if (ProgramBinaryCache::instance().enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        return program;
+    }
+    // a failed compile always fails the link, so only the link status is waited
+    // on; the stage logs are fetched when something went wrong
+    // ------------------------------------------------------------------------
+    static bool finishProgram(unsigned int program, unsigned int shaders[2])
+    {
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            checkCompileErrors(shaders[0], "VERTEX");
+            checkCompileErrors(shaders[1], "FRAGMENT");
+            checkCompileErrors(program, "PROGRAM");
+        }
         // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        glDetachShader(program, shaders[0]);
+        glDetachShader(program, shaders[1]);
+        glDeleteShader(shaders[0]);
+        glDeleteShader(shaders[1]);
+        return success != 0;
     }
-    // activate the shader
+    // flat uniform table: slots hold the resolved locations, buckets is an
+    // open-addressed index into slots keyed by the name hash
+    struct UniformSlot
+    {
+        std::string name;
+        uint64_t hash;
+        int location;
+    };
+    std::vector<UniformSlot> uniformSlots;
+    std::vector<int> uniformBuckets;
+
     // ------------------------------------------------------------------------
-    void use()
+    int locationOf(UniformHandle handle) const
     {
-        glUseProgram(ID);
+        // GL silently ignores uploads to location -1, same as an unknown name
+        return handle.slot >= 0 ? uniformSlots[handle.slot].location : -1;
+    }
+    // ------------------------------------------------------------------------
+    int findSlot(const char* name, uint64_t hash) const
+    {
+        if (uniformBuckets.empty())
+            return -1;
+        size_t mask = uniformBuckets.size() - 1;
+        for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask)
+        {
+            int slot = uniformBuckets[i];
+            if (slot < 0)
+                return -1;
+            if (uniformSlots[slot].hash == hash && uniformSlots[slot].name == name)
+                return slot;
+        }
     }
-    // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    int findLocation(const char* name) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        int slot = findSlot(name, HashString(name));
+        return slot >= 0 ? uniformSlots[slot].location : -1;
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    int findOrAddSlot(const char* name, uint64_t hash)
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        int slot = findSlot(name, hash);
+        if (slot >= 0)
+            return slot;
+        // keep the load factor at or below one half
+        if ((uniformSlots.size() + 1) * 2 > uniformBuckets.size())
+            rehashUniforms(uniformBuckets.empty() ? 16 : uniformBuckets.size() * 2);
+        slot = (int)uniformSlots.size();
+        uniformSlots.push_back({ name, hash, -1 });
+        insertBucket(slot);
+        return slot;
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    void insertBucket(int slot)
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        size_t mask = uniformBuckets.size() - 1;
+        size_t i = (size_t)uniformSlots[slot].hash & mask;
+        while (uniformBuckets[i] >= 0)
+            i = (i + 1) & mask;
+        uniformBuckets[i] = slot;
     }
+    // ------------------------------------------------------------------------
+    void rehashUniforms(size_t bucketCount)
+    {
+        uniformBuckets.assign(bucketCount, -1);
+        for (int slot = 0; slot < (int)uniformSlots.size(); ++slot)
+            insertBucket(slot);
+    }
+    // query every active uniform once after linking. Existing slots are kept
+    // (and reset) so handles taken before a relink stay valid.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        for (UniformSlot& slot : uniformSlots)
+            slot.location = -1;
 
-private:
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(maxLength > 0 ? maxLength : 1);
+        for (int i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            int location = glGetUniformLocation(ID, name.data());
+            // members of uniform blocks have no location
+            if (location < 0)
+                continue;
+            std::string uniformName(name.data(), length);
+            uniformSlots[findOrAddSlot(uniformName.c_str(), HashString(uniformName.c_str()))].location = location;
+            // arrays report "name[0]"; also register the bare name and every element
+            size_t bracket = uniformName.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            {
+                std::string baseName = uniformName.substr(0, bracket);
+                uniformSlots[findOrAddSlot(baseName.c_str(), HashString(baseName.c_str()))].location = location;
+                for (int element = 1; element < size; ++element)
+                {
+                    std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                    uniformSlots[findOrAddSlot(elementName.c_str(), HashString(elementName.c_str()))].location =
+                        glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+    // attach the program's uniform and storage blocks to the engine's fixed binding points
+    // ------------------------------------------------------------------------
+    void bindUniformBlocks()
+    {
+        int count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for (int i = 0; i < count; ++i)
+        {
+            char name[128];
+            glGetActiveUniformBlockName(ID, (GLuint)i, sizeof(name), NULL, name);
+            int binding = UniformBlockBinding(name);
+            if (binding >= 0)
+                glUniformBlockBinding(ID, (GLuint)i, (GLuint)binding);
+        }
+
+        // shader storage blocks (GL 4.3), e.g. the multi-draw records
+        if (!(GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query) && !GLEW_VERSION_4_3)
+            return;
+        glGetProgramInterfaceiv(ID, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &count);
+        for (int i = 0; i < count; ++i)
+        {
+            char name[128];
+            glGetProgramResourceName(ID, GL_SHADER_STORAGE_BLOCK, (GLuint)i, sizeof(name), NULL, name);
+            int binding = StorageBlockBinding(name);
+            if (binding >= 0)
+                glShaderStorageBlockBinding(ID, (GLuint)i, (GLuint)binding);
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(unsigned int shader, std::string type)
+    static bool checkCompileErrors(unsigned int shader, std::string type)
     {
         int success;
         char infoLog[1024];
@@ -118,6 +404,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
@@ -0,0 +1,1318 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "BasicShader.h"
+#include "ProgramBinaryCache.h"
+#include "MeshOptimizer.h"
+#include "Primitives.h"
+#include "VertexPacking.h"
+#include "GeometryPool.h"
+#include "MultiDraw.h"
+#include "InstanceBatcher.h"
+#include "HiZPyramid.h"
+#include "GpuCulling.h"
+#include "RenderQueue.h"
+#include "CommandList.h"
+#include "JobSystem.h"
+#include "FiberScheduler.h"
+#include "InputSystem.h"
+#include "Profiler.h"
+#include "UniformBuffer.h"
+
+// Micro-benchmarks run from the command line (see main()). They need a current
+// GL context but do not touch the render loop, unless noted otherwise.
+
+// Uniform updates: 10k glUniform1f calls per frame, comparing the old
+// glGetUniformLocation-per-call path against pre-resolved handles.
+// ------------------------------------------------------------------------
+inline void RunUniformBenchmark()
+{
+    const int UNIFORMS_PER_FRAME = 10000;
+    const int FRAMES = 120;
+    const int UNIFORM_COUNT = 16;
+
+    Shader shader("res/shaders/UniformBenchVertex.shader", "res/shaders/UniformBenchFragment.shader");
+    shader.use();
+
+    const char* names[UNIFORM_COUNT];
+    std::string nameStorage[UNIFORM_COUNT];
+    UniformHandle handles[UNIFORM_COUNT];
+    for (int i = 0; i < UNIFORM_COUNT; ++i)
+    {
+        nameStorage[i] = "uWeights[" + std::to_string(i) + "]";
+        names[i] = nameStorage[i].c_str();
+        handles[i] = shader.uniform(names[i]);
+    }
+
+    // the pre-cache setter: a std::string temporary and a driver lookup per call
+    auto legacySetFloat = [&shader](const std::string& name, float value)
+    {
+        glUniform1f(glGetUniformLocation(shader.ID, name.c_str()), value);
+    };
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    glFinish();
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < FRAMES; ++frame)
+    {
+        for (int i = 0; i < UNIFORMS_PER_FRAME; ++i)
+            legacySetFloat(names[i % UNIFORM_COUNT], (float)i);
+        glFinish();
+    }
+    double legacyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int frame = 0; frame < FRAMES; ++frame)
+    {
+        for (int i = 0; i < UNIFORMS_PER_FRAME; ++i)
+            shader.setFloat(handles[i % UNIFORM_COUNT], (float)i);
+        glFinish();
+    }
+    double handleMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    double calls = (double)FRAMES * UNIFORMS_PER_FRAME;
+    std::cout << "Uniform benchmark (" << UNIFORMS_PER_FRAME << " uniforms/frame, " << FRAMES << " frames)" << std::endl;
+    std::cout << "  glGetUniformLocation: " << legacyMs / FRAMES << " ms/frame, " << legacyMs * 1e6 / calls << " ns/call" << std::endl;
+    std::cout << "  UniformHandle:        " << handleMs / FRAMES << " ms/frame, " << handleMs * 1e6 / calls << " ns/call" << std::endl;
+    std::cout << "  speedup:              " << legacyMs / handleMs << "x" << std::endl;
+}
+
+// Program binary cache: builds programCount distinct programs from the main
+// shaders with an empty cache (cold start), then again with the cache filled
+// (warm start). Note the driver may keep its own shader cache, which makes the
+// cold numbers look better than a first launch on a clean machine.
+// ------------------------------------------------------------------------
+inline void RunShaderCacheBenchmark(int programCount)
+{
+    ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+    if (!cache.enabled())
+        std::cout << "Program binaries are not supported by this driver, both runs will compile." << std::endl;
+    cache.clear();
+
+    std::cout << "Shader cache benchmark (" << programCount << " programs)" << std::endl;
+    double passMs[2];
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        cache.stats() = ProgramBinaryCache::Stats();
+        std::vector<unsigned int> programs;
+        for (int i = 0; i < programCount; ++i)
+        {
+            // a distinct define per program gives every one its own cache entry
+            Shader shader("res/shaders/VertexShader.shader", "res/shaders/FragmentShader.shader",
+                "#define CB_BENCH_VARIANT " + std::to_string(i));
+            programs.push_back(shader.ID);
+        }
+        glFinish();
+        passMs[pass] = cache.stats().totalMs;
+        std::cout << (pass == 0 ? "  cold start: " : "  warm start: ") << passMs[pass] << " ms, "
+            << passMs[pass] / programCount << " ms/program (hits " << cache.stats().hits
+            << ", misses " << cache.stats().misses << ")" << std::endl;
+        for (unsigned int program : programs)
+            glDeleteProgram(program);
+    }
+    std::cout << "  speedup: " << passMs[0] / passMs[1] << "x for " << programCount << " programs" << std::endl;
+}
+
+// Mesh optimizer: ACMR/ATVR (16-entry FIFO) before, after the vertex cache
+// pass alone and after OptimizeMesh (overdraw + fetch) over procedural
+// meshes, both in generated order and scrambled like a bad export. CPU
+// only, needs no GL context.
+// ------------------------------------------------------------------------
+inline void RunMeshOptimizerBenchmark()
+{
+    struct Entry { const char* name; MeshData mesh; };
+    std::vector<Entry> corpus;
+    corpus.push_back({ "grid 256x256", MakeGrid(256) });
+    corpus.push_back({ "sphere 128x96", MakeSphere(128, 96) });
+    corpus.push_back({ "torus 192x64", MakeTorus(192, 64) });
+    corpus.push_back({ "sphere 16x12", MakeSphere(16, 12) });
+    size_t generated = corpus.size();
+    for (size_t i = 0; i < generated; ++i)
+    {
+        Entry scrambled = { corpus[i].name, corpus[i].mesh };
+        ScrambleMesh(scrambled.mesh);
+        corpus.push_back(scrambled);
+    }
+
+    typedef std::chrono::high_resolution_clock Clock;
+    std::cout << "Mesh optimizer benchmark (" << corpus.size() << " meshes, FIFO cache of 16)" << std::endl;
+    double totalMs = 0.0;
+    unsigned long long totalTriangles = 0;
+    for (size_t i = 0; i < corpus.size(); ++i)
+    {
+        MeshData& mesh = corpus[i].mesh;
+        VertexCacheStats before = AnalyzeVertexCache(mesh.indices, mesh.vertexCount());
+        // the cache pass on its own, on a copy
+        std::vector<uint32_t> cacheOrder(mesh.indices);
+        OptimizeVertexCache(cacheOrder, mesh.vertexCount());
+        VertexCacheStats cached = AnalyzeVertexCache(cacheOrder, mesh.vertexCount());
+
+        Clock::time_point start = Clock::now();
+        OptimizeMesh(mesh.vertices, MeshData::FLOATS_PER_VERTEX, mesh.indices);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        VertexCacheStats after = AnalyzeVertexCache(mesh.indices, mesh.vertexCount());
+        totalMs += ms;
+        totalTriangles += mesh.triangleCount();
+
+        std::cout << "  " << corpus[i].name << (i >= generated ? " (scrambled)" : "") << ", " << mesh.triangleCount() << " triangles: ACMR "
+            << before.acmr << " -> " << cached.acmr << " (vertex cache) -> " << after.acmr << " (overdraw + fetch), ATVR "
+            << before.atvr << " -> " << cached.atvr << " -> " << after.atvr << ", " << ms << " ms" << std::endl;
+    }
+    std::cout << "  total: " << totalMs << " ms, " << totalTriangles / (totalMs * 1000.0) << " M triangles/s" << std::endl;
+}
+
+// Multi-draw indirect: drawCount distinct small meshes (jittered boxes, each
+// with its own dequantization bounds) from one GeometryPool, submitted as one
+// glMultiDrawElementsIndirect and as the per-draw loop it replaces. Times the
+// CPU submission and the whole frame (glFinish) separately.
+// ------------------------------------------------------------------------
+inline void RunMultiDrawBenchmark(unsigned int drawCount)
+{
+    const int FRAMES = 30;
+    if (!MultiDrawBatch::isSupported())
+        std::cout << "Multi-draw indirect is not supported by this driver, only the per-draw loop runs." << std::endl;
+
+    GeometryPool pool;
+    std::vector<GeometryHandle> meshes;
+    PackedVertexFormat format;
+    format.color = true;
+    uint32_t seed = 1;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    for (unsigned int i = 0; i < drawCount; ++i)
+    {
+        MeshData box = MakeBox(Vec3(0.5f + random(), 0.5f + random(), 0.5f + random()));
+        std::vector<SourceVertex> vertices;
+        for (unsigned int v = 0; v < box.vertexCount(); ++v)
+        {
+            const float* p = &box.vertices[v * MeshData::FLOATS_PER_VERTEX];
+            vertices.push_back(SourceVertex(Vec3(p[0] + random() * 0.2f, p[1], p[2]), Vec4(p[3], p[4], p[5], 1.0f)));
+        }
+        VertexPacker packer(format, QuantizationBounds::fromVertices(vertices));
+        std::vector<unsigned char> packed = packer.pack(vertices);
+        meshes.push_back(pool.add(packer.getLayout(), packed.data(), (uint32_t)vertices.size(), box.indices, GL_TRIANGLES, packer.getBounds()));
+    }
+    GeometryPool::Stats poolStats = pool.getStats();
+    std::cout << "Multi-draw benchmark (" << drawCount << " meshes, " << poolStats.arenas << " arena(s), "
+        << (poolStats.vertexBytes + poolStats.indexBytes) / 1024 << " KiB of geometry)" << std::endl;
+
+    const char* vertexPath = "res/shaders/VertexShader.shader";
+    const char* fragmentPath = "res/shaders/FragmentShader.shader";
+    Shader perDrawShader(vertexPath, fragmentPath, "#define VERTEX_COLOR 1\n");
+    std::unique_ptr<Shader> multiDrawShader;
+    if (MultiDrawBatch::isSupported())
+        multiDrawShader.reset(new Shader(vertexPath, fragmentPath, "#define VERTEX_COLOR 1\n#define MULTI_DRAW 1\n"));
+    UniformBuffer<FrameBlock> frameUniforms(UNIFORM_BINDING_FRAME);
+    UniformBuffer<MaterialBlock> materialUniforms(UNIFORM_BINDING_MATERIAL);
+    FrameBlock frame;
+    frame.view = frame.projection = frame.viewProjection = Mat4::identity();
+    frameUniforms.update(frame);
+    MaterialBlock material;
+    material.baseColor = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    materialUniforms.update(material);
+
+    // every object gets its own cell of a grid covering the viewport
+    unsigned int columns = (unsigned int)std::ceil(std::sqrt((double)drawCount));
+    float cell = 2.0f / columns;
+    std::vector<ObjectBlock> objects(drawCount);
+    for (unsigned int i = 0; i < drawCount; ++i)
+    {
+        float x = -1.0f + cell * (i % columns + 0.5f), y = -1.0f + cell * (i / columns + 0.5f);
+        objects[i].model = Mat4::translation(Vec3(x, y, 0.0f)) * Mat4::scale(Vec3(cell * 0.25f, cell * 0.25f, cell * 0.25f));
+        objects[i].color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    // per-draw records need one aligned block each in the ring
+    MultiDrawBatch batch(pool, drawCount);
+    UniformRing objectUniforms(UNIFORM_BINDING_OBJECT, drawCount * 256);
+    typedef std::chrono::high_resolution_clock Clock;
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        bool multiDraw = mode == 1;
+        if (multiDraw && !MultiDrawBatch::isSupported())
+            break;
+        (multiDraw ? *multiDrawShader : perDrawShader).use();
+
+        double submitMs = 0.0, frameMs = 0.0;
+        for (int frameIndex = 0; frameIndex < FRAMES + 1; ++frameIndex)
+        {
+            glFinish();
+            Clock::time_point start = Clock::now();
+            batch.begin();
+            objectUniforms.beginFrame();
+            for (unsigned int i = 0; i < drawCount; ++i)
+                batch.add(meshes[i], objects[i]);
+            if (multiDraw)
+                batch.submit();
+            else
+                batch.submitPerDraw(objectUniforms);
+            batch.end();
+            objectUniforms.endFrame();
+            Clock::time_point submitted = Clock::now();
+            glFinish();
+            // the first frame warms up driver state and is not counted
+            if (frameIndex > 0)
+            {
+                submitMs += std::chrono::duration<double, std::milli>(submitted - start).count();
+                frameMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+        }
+        std::cout << (multiDraw ? "  multi-draw indirect: " : "  per-draw loop:       ") << submitMs / FRAMES << " ms submit, "
+            << frameMs / FRAMES << " ms frame, " << batch.getStats().calls << " draw call(s)" << std::endl;
+    }
+    glDeleteProgram(perDrawShader.ID);
+    if (multiDrawShader)
+        glDeleteProgram(multiDrawShader->ID);
+}
+
+// Instancing: instanceCount copies of 3 meshes x 2 materials in random
+// order, drawn one glDrawElementsBaseVertex each and through the
+// InstanceBatcher (6 instanced draws).
+// ------------------------------------------------------------------------
+inline void RunInstancingBenchmark(unsigned int instanceCount)
+{
+    const int FRAMES = 30;
+    const unsigned int MESHES = 3, MATERIALS = 2;
+
+    GeometryPool pool;
+    PackedVertexFormat format;
+    format.color = true;
+    GeometryHandle meshes[MESHES];
+    for (unsigned int m = 0; m < MESHES; ++m)
+    {
+        MeshData data = m == 0 ? MakeBox(Vec3(1.0f, 1.0f, 1.0f)) : MakeSphere(6 + 4 * m, 4 + 2 * m);
+        std::vector<SourceVertex> vertices;
+        for (unsigned int v = 0; v < data.vertexCount(); ++v)
+        {
+            const float* p = &data.vertices[v * MeshData::FLOATS_PER_VERTEX];
+            vertices.push_back(SourceVertex(Vec3(p[0], p[1], p[2]), Vec4(p[3], p[4], p[5], 1.0f)));
+        }
+        VertexPacker packer(format, QuantizationBounds::fromVertices(vertices));
+        std::vector<unsigned char> packed = packer.pack(vertices);
+        meshes[m] = pool.add(packer.getLayout(), packed.data(), (uint32_t)vertices.size(), data.indices, GL_TRIANGLES, packer.getBounds());
+    }
+
+    const char* vertexPath = "res/shaders/VertexShader.shader";
+    const char* fragmentPath = "res/shaders/FragmentShader.shader";
+    Shader loopShader(vertexPath, fragmentPath, "#define VERTEX_COLOR 1\n");
+    Shader instancedShader(vertexPath, fragmentPath, "#define VERTEX_COLOR 1\n#define INSTANCING 1\n");
+    UniformBuffer<FrameBlock> frameUniforms(UNIFORM_BINDING_FRAME);
+    FrameBlock frame;
+    frame.view = frame.projection = frame.viewProjection = Mat4::identity();
+    frameUniforms.update(frame);
+    UniformBuffer<MaterialBlock> materials[MATERIALS] = { UniformBuffer<MaterialBlock>(UNIFORM_BINDING_MATERIAL), UniformBuffer<MaterialBlock>(UNIFORM_BINDING_MATERIAL) };
+    for (unsigned int m = 0; m < MATERIALS; ++m)
+    {
+        MaterialBlock material;
+        material.baseColor = m == 0 ? Vec4(1.0f, 1.0f, 1.0f, 1.0f) : Vec4(0.6f, 0.9f, 0.6f, 1.0f);
+        materials[m].update(material);
+    }
+
+    uint32_t seed = 7;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    struct Placement { unsigned int mesh, material; InstanceData instance; };
+    std::vector<Placement> placements(instanceCount);
+    for (Placement& placement : placements)
+    {
+        placement.mesh = (unsigned int)(random() * MESHES) % MESHES;
+        placement.material = (unsigned int)(random() * MATERIALS) % MATERIALS;
+        float size = 0.002f + random() * 0.01f;
+        placement.instance.model = Mat4::translation(Vec3(random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, 0.0f)) * Mat4::scale(Vec3(size, size, size));
+        placement.instance.color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    InstanceBatcher batcher(pool, instanceCount);
+    UniformRing objectUniforms(UNIFORM_BINDING_OBJECT, instanceCount * 256);
+    std::cout << "Instancing benchmark (" << instanceCount << " instances, " << MESHES << " meshes x " << MATERIALS << " materials)" << std::endl;
+    typedef std::chrono::high_resolution_clock Clock;
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        bool instanced = mode == 1;
+        (instanced ? instancedShader : loopShader).use();
+        double submitMs = 0.0, frameMs = 0.0;
+        unsigned int calls = 0;
+        for (int frameIndex = 0; frameIndex < FRAMES + 1; ++frameIndex)
+        {
+            glFinish();
+            Clock::time_point start = Clock::now();
+            objectUniforms.beginFrame();
+            if (instanced)
+            {
+                batcher.begin();
+                for (const Placement& placement : placements)
+                    batcher.add(meshes[placement.mesh], placement.material, placement.instance);
+                batcher.submit(objectUniforms, [&materials](unsigned int material) { materials[material].bind(); });
+                batcher.end();
+                calls = batcher.getStats().batches;
+            }
+            else
+            {
+                for (const Placement& placement : placements)
+                {
+                    materials[placement.material].bind();
+                    const GeometryRange& range = pool.get(meshes[placement.mesh]);
+                    ObjectBlock object;
+                    object.model = placement.instance.model;
+                    object.color = placement.instance.color;
+                    object.positionScale = Vec4(range.quantization.scale, 0.0f);
+                    object.positionOffset = Vec4(range.quantization.offset, 0.0f);
+                    objectUniforms.pushAndBind(object);
+                    pool.draw(meshes[placement.mesh]);
+                }
+                calls = instanceCount;
+            }
+            objectUniforms.endFrame();
+            Clock::time_point submitted = Clock::now();
+            glFinish();
+            // the first frame warms up driver state and is not counted
+            if (frameIndex > 0)
+            {
+                submitMs += std::chrono::duration<double, std::milli>(submitted - start).count();
+                frameMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+        }
+        std::cout << (instanced ? "  instanced:     " : "  per-draw loop: ") << submitMs / FRAMES << " ms submit, "
+            << frameMs / FRAMES << " ms frame, " << calls << " draw call(s)" << std::endl;
+    }
+    glDeleteProgram(loopShader.ID);
+    glDeleteProgram(instancedShader.ID);
+}
+
+// Scene shared by the culling self-check and benchmark: objectCount spheres
+// scattered through a 120 unit cube around the origin, drawing 4 boxes
+// ------------------------------------------------------------------------
+inline void MakeCullingScene(GeometryPool& pool, GpuCulling& culling, unsigned int objectCount)
+{
+    uint32_t seed = 7;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    GeometryHandle meshes[4];
+    for (int m = 0; m < 4; ++m)
+    {
+        MeshData box = MakeBox(Vec3(0.5f + 0.5f * m, 0.5f, 0.5f));
+        // one mesh as lines, so the arena splits into a group per primitive mode
+        meshes[m] = pool.add(MeshData::layout(), box.vertices.data(), box.vertexCount(), box.indices, m == 3 ? GL_LINES : GL_TRIANGLES);
+    }
+    for (unsigned int i = 0; i < objectCount; ++i)
+    {
+        Vec3 centre(random() * 120.0f - 60.0f, random() * 120.0f - 60.0f, random() * 120.0f - 60.0f);
+        float radius = 0.2f + random() * 3.0f;
+        ObjectBlock object;
+        object.model = Mat4::translation(centre) * Mat4::scale(Vec3(radius * 0.5f, radius, radius));
+        object.color = Vec4(random(), random(), random(), 1.0f);
+        culling.add(meshes[i % 4], Vec4(centre.x, centre.y, centre.z, radius), object);
+    }
+}
+// Window depth with random rectangular occluders in front of the far plane
+// ------------------------------------------------------------------------
+inline std::vector<float> MakeOccluderDepth(unsigned int width, unsigned int height, unsigned int occluders)
+{
+    uint32_t seed = 11;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    std::vector<float> depth((size_t)width * height, 1.0f);
+    for (unsigned int o = 0; o < occluders; ++o)
+    {
+        unsigned int x0 = (unsigned int)(random() * width), y0 = (unsigned int)(random() * height);
+        unsigned int x1 = std::min(width, x0 + 1 + (unsigned int)(random() * width / 3));
+        unsigned int y1 = std::min(height, y0 + 1 + (unsigned int)(random() * height / 3));
+        float value = 0.9f + random() * 0.1f;
+        for (unsigned int y = y0; y < y1; ++y)
+            for (unsigned int x = x0; x < x1; ++x)
+                depth[(size_t)y * width + x] = std::min(depth[(size_t)y * width + x], value);
+    }
+    return depth;
+}
+// ------------------------------------------------------------------------
+inline unsigned int MakeDepthTexture(const std::vector<float>& depth, unsigned int width, unsigned int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    GLStateCache::instance().bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, (GLsizei)width, (GLsizei)height);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)width, (GLsizei)height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+// GPU culling self-check: culls objectCount spheres from several viewpoints,
+// frustum only and against a Hi-Z pyramid of random occluders, with the
+// compute pass and with the CullSphere() reference, and compares them object
+// by object. Every object is compared. GLSL allows division and the matrix
+// product to round differently from the CPU (division alone is 2.5 ulp), so
+// a disagreement is tolerated only when the CPU decision came within
+// TOLERANCE of flipping: a few ulp of the largest values compared (clip w and
+// plane distances up to ~200, texel coordinates up to the Hi-Z size). Those
+// are counted and reported; any other disagreement fails. Also compares
+// every pyramid level with DepthPyramid and the compacted counts with the
+// visibility flags. Meant to run on any driver, Mesa llvmpipe included
+// (LIBGL_ALWAYS_SOFTWARE=1). Returns false on any mismatch.
+// ------------------------------------------------------------------------
+inline bool VerifyGpuCulling(unsigned int objectCount)
+{
+    const float TOLERANCE = 1e-4f;
+    const unsigned int WIDTH = 157, HEIGHT = 113;
+    if (!GpuCulling::isSupported() || !HiZPyramid::isSupported())
+    {
+        std::cout << "GPU culling is not supported by this driver (needs compute shaders, multi-draw indirect and shader draw parameters)." << std::endl;
+        return false;
+    }
+    bool passed = true;
+
+    // odd sizes exercise the 3-wide reduction at the pyramid's edges
+    std::vector<float> depth = MakeOccluderDepth(WIDTH, HEIGHT, 40);
+    DepthPyramid reference = DepthPyramid::build(depth.data(), WIDTH, HEIGHT);
+    unsigned int depthTexture = MakeDepthTexture(depth, WIDTH, HEIGHT);
+    HiZPyramid hiZ(WIDTH, HEIGHT);
+    hiZ.build(depthTexture);
+    GLStateCache::instance().bindTexture(0, GL_TEXTURE_2D, hiZ.getTexture());
+    for (unsigned int level = 0; level < hiZ.getLevelCount(); ++level)
+    {
+        std::vector<float> texels(reference.levels[level].size());
+        glGetTexImage(GL_TEXTURE_2D, (GLint)level, GL_RED, GL_FLOAT, texels.data());
+        if (texels != reference.levels[level])
+        {
+            std::cout << "  Hi-Z level " << level << " differs from the CPU pyramid" << std::endl;
+            passed = false;
+        }
+    }
+
+    GeometryPool pool;
+    GpuCulling culling(pool);
+    MakeCullingScene(pool, culling, objectCount);
+    std::cout << "GPU culling check (" << objectCount << " objects, " << hiZ.getLevelCount() << " Hi-Z levels, draw count from "
+        << (culling.hasDrawCount() ? "the counter buffer" : "zeroed commands") << ")" << std::endl;
+
+    Shader drawShader("res/shaders/VertexShader.shader", "res/shaders/FragmentShader.shader", "#define VERTEX_COLOR 1\n#define MULTI_DRAW 1\n");
+    UniformBuffer<FrameBlock> frameUniforms(UNIFORM_BINDING_FRAME);
+    Mat4 projection = Mat4::perspective(1.047f, (float)WIDTH / HEIGHT, 0.5f, 200.0f);
+    // outside looking in, from the side, inside the cloud, from straight above
+    Mat4 views[4] = {
+        Mat4::lookAt(Vec3(0.0f, 0.0f, 90.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)),
+        Mat4::lookAt(Vec3(70.0f, 30.0f, -40.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)),
+        Mat4::lookAt(Vec3(0.0f, 0.0f, 0.0f), Vec3(1.0f, 0.2f, 0.3f), Vec3(0.0f, 1.0f, 0.0f)),
+        Mat4::lookAt(Vec3(5.0f, 80.0f, 5.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 0.0f, 1.0f)),
+    };
+    for (int v = 0; v < 4; ++v)
+        for (int occlusion = 0; occlusion < 2; ++occlusion)
+        {
+            Mat4 viewProjection = projection * views[v];
+            culling.cull(viewProjection, occlusion ? &hiZ : nullptr);
+            std::vector<uint32_t> visibility = culling.readVisibility();
+            unsigned int visibleCount = culling.readVisibleCount();
+
+            CullViewBlock view = CullViewBlock::fromMatrix(viewProjection);
+            unsigned int flagged = 0, expected = 0, mismatches = 0, tolerated = 0;
+            for (unsigned int i = 0; i < objectCount; ++i)
+            {
+                float margin = 0.0f;
+                bool visible = CullSphere(culling.getSphere(i), view, occlusion ? &reference : nullptr, &margin);
+                flagged += visibility[i];
+                expected += visible ? 1 : 0;
+                if (visible == (visibility[i] != 0))
+                    continue;
+                if (margin < TOLERANCE)
+                {
+                    tolerated++;
+                    continue;
+                }
+                if (mismatches < 5)
+                    std::cout << "    object " << i << ": GPU says " << (visibility[i] ? "visible" : "culled") << ", CPU " << (visible ? "visible" : "culled")
+                        << " (margin " << margin << ")" << std::endl;
+                mismatches++;
+            }
+            std::cout << "  view " << v << (occlusion ? ", frustum + Hi-Z: " : ", frustum only:  ") << visibleCount << " visible (CPU "
+                << expected << "), " << mismatches << " mismatch(es), " << tolerated << " within tolerance" << std::endl;
+            if (mismatches > 0 || visibleCount != flagged)
+                passed = false;
+
+            // the compacted commands must be drawable as they are
+            FrameBlock frame;
+            frame.view = views[v];
+            frame.projection = projection;
+            frame.viewProjection = viewProjection;
+            frameUniforms.update(frame);
+            drawShader.use();
+            culling.draw();
+        }
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR)
+    {
+        std::cout << "  GL error 0x" << std::hex << error << std::dec << std::endl;
+        passed = false;
+    }
+    glDeleteProgram(drawShader.ID);
+    glDeleteTextures(1, &depthTexture);
+    std::cout << (passed ? "GPU culling matches the CPU reference." : "GPU culling does NOT match the CPU reference!") << std::endl;
+    return passed;
+}
+
+// GPU culling cost: objectCount objects through the CullSphere() reference
+// loop (what CPU culling would spend) and through the compute pass
+// (dispatch to glFinish), frustum only and with the Hi-Z test
+// ------------------------------------------------------------------------
+inline void RunCullingBenchmark(unsigned int objectCount)
+{
+    const int FRAMES = 30;
+    const unsigned int WIDTH = 640, HEIGHT = 360;
+    if (!GpuCulling::isSupported() || !HiZPyramid::isSupported())
+    {
+        std::cout << "GPU culling is not supported by this driver." << std::endl;
+        return;
+    }
+    std::vector<float> depth = MakeOccluderDepth(WIDTH, HEIGHT, 40);
+    DepthPyramid reference = DepthPyramid::build(depth.data(), WIDTH, HEIGHT);
+    unsigned int depthTexture = MakeDepthTexture(depth, WIDTH, HEIGHT);
+    HiZPyramid hiZ(WIDTH, HEIGHT);
+    GeometryPool pool;
+    GpuCulling culling(pool);
+    MakeCullingScene(pool, culling, objectCount);
+    Mat4 viewProjection = Mat4::perspective(1.047f, (float)WIDTH / HEIGHT, 0.5f, 200.0f) *
+        Mat4::lookAt(Vec3(0.0f, 0.0f, 90.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+    CullViewBlock view = CullViewBlock::fromMatrix(viewProjection);
+    std::cout << "Culling benchmark (" << objectCount << " objects, " << WIDTH << "x" << HEIGHT << " Hi-Z)" << std::endl;
+
+    typedef std::chrono::high_resolution_clock Clock;
+    for (int occlusion = 0; occlusion < 2; ++occlusion)
+    {
+        double cpuMs = 0.0, gpuMs = 0.0;
+        unsigned int visible = 0;
+        for (int frameIndex = 0; frameIndex < FRAMES + 1; ++frameIndex)
+        {
+            Clock::time_point start = Clock::now();
+            visible = 0;
+            for (unsigned int i = 0; i < objectCount; ++i)
+                visible += CullSphere(culling.getSphere(i), view, occlusion ? &reference : nullptr) ? 1 : 0;
+            Clock::time_point cpuDone = Clock::now();
+
+            glFinish();
+            Clock::time_point gpuStart = Clock::now();
+            if (occlusion)
+                hiZ.build(depthTexture);
+            culling.cull(viewProjection, occlusion ? &hiZ : nullptr);
+            glFinish();
+            // the first frame uploads the objects and is not counted
+            if (frameIndex > 0)
+            {
+                cpuMs += std::chrono::duration<double, std::milli>(cpuDone - start).count();
+                gpuMs += std::chrono::duration<double, std::milli>(Clock::now() - gpuStart).count();
+            }
+        }
+        std::cout << (occlusion ? "  frustum + Hi-Z: " : "  frustum only:   ") << cpuMs / FRAMES << " ms CPU reference, "
+            << gpuMs / FRAMES << " ms GPU" << (occlusion ? " (incl. pyramid build)" : "") << ", " << visible << " visible" << std::endl;
+    }
+    glDeleteTextures(1, &depthTexture);
+}
+
+// Render queue: drawCount draws over 4 programs x 16 materials x 8 meshes in
+// random order, issued as they come (only the state cache filtering) and
+// through the sorted RenderQueue, per draw and with multi-draw runs. Sorting
+// is part of the submit time.
+// ------------------------------------------------------------------------
+inline void RunRenderQueueBenchmark(unsigned int drawCount)
+{
+    const int FRAMES = 30;
+    const unsigned int PROGRAMS = 4, MATERIALS = 16, MESHES = 8;
+
+    GeometryPool pool;
+    GeometryHandle meshes[MESHES];
+    for (unsigned int m = 0; m < MESHES; ++m)
+    {
+        MeshData data = m % 2 == 0 ? MakeBox(Vec3(1.0f, 0.5f + 0.25f * m, 1.0f)) : MakeSphere(6 + 2 * m, 4 + m);
+        meshes[m] = pool.add(MeshData::layout(), data.vertices.data(), data.vertexCount(), data.indices);
+    }
+
+    // distinct programs from the same sources, with and without MULTI_DRAW
+    const char* vertexPath = "res/shaders/VertexShader.shader";
+    const char* fragmentPath = "res/shaders/FragmentShader.shader";
+    const char* programDefines[PROGRAMS] = { "", "#define VERTEX_COLOR 1\n", "#define WIREFRAME 1\n", "#define VERTEX_COLOR 1\n#define WIREFRAME 1\n" };
+    std::vector<std::unique_ptr<Shader>> programs, multiDrawPrograms;
+    for (unsigned int p = 0; p < PROGRAMS; ++p)
+    {
+        programs.emplace_back(new Shader(vertexPath, fragmentPath, programDefines[p]));
+        if (MultiDrawBatch::isSupported())
+            multiDrawPrograms.emplace_back(new Shader(vertexPath, fragmentPath, std::string(programDefines[p]) + "#define MULTI_DRAW 1\n"));
+    }
+    std::vector<std::unique_ptr<UniformBuffer<MaterialBlock>>> materials;
+    for (unsigned int m = 0; m < MATERIALS; ++m)
+    {
+        materials.emplace_back(new UniformBuffer<MaterialBlock>(UNIFORM_BINDING_MATERIAL));
+        MaterialBlock material;
+        material.baseColor = Vec4(0.5f + m / 32.0f, 1.0f - m / 32.0f, 1.0f, 1.0f);
+        materials[m]->update(material);
+    }
+    auto bindMaterial = [&materials](unsigned int material) { materials[material]->bind(); };
+
+    Mat4 viewProjection = Mat4::perspective(1.047f, 4.0f / 3.0f, 0.5f, 200.0f) *
+        Mat4::lookAt(Vec3(0.0f, 0.0f, 60.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+    UniformBuffer<FrameBlock> frameUniforms(UNIFORM_BINDING_FRAME);
+    FrameBlock frame;
+    frame.view = frame.projection = Mat4::identity();
+    frame.viewProjection = viewProjection;
+    frameUniforms.update(frame);
+
+    uint32_t seed = 3;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    struct Placement { unsigned int program, material, mesh; Vec3 position; ObjectBlock object; };
+    std::vector<Placement> placements(drawCount);
+    for (Placement& placement : placements)
+    {
+        placement.program = (unsigned int)(random() * PROGRAMS) % PROGRAMS;
+        placement.material = (unsigned int)(random() * MATERIALS) % MATERIALS;
+        placement.mesh = (unsigned int)(random() * MESHES) % MESHES;
+        placement.position = Vec3(random() * 60.0f - 30.0f, random() * 40.0f - 20.0f, random() * -60.0f);
+        placement.object.model = Mat4::translation(placement.position) * Mat4::scale(Vec3(0.2f, 0.2f, 0.2f));
+        placement.object.color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    RenderQueue queue(pool);
+    MultiDrawBatch batch(pool, drawCount);
+    UniformRing objectUniforms(UNIFORM_BINDING_OBJECT, drawCount * 256);
+    std::cout << "Render queue benchmark (" << drawCount << " draws, " << PROGRAMS << " programs x " << MATERIALS << " materials x "
+        << MESHES << " meshes)" << std::endl;
+    typedef std::chrono::high_resolution_clock Clock;
+    const char* names[3] = { "  submission order:    ", "  sorted, per draw:    ", "  sorted, multi-draw:  " };
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        bool multiDraw = mode == 2;
+        if (multiDraw && !MultiDrawBatch::isSupported())
+            break;
+        double submitMs = 0.0, frameMs = 0.0;
+        unsigned int programChanges = 0, materialChanges = 0;
+        for (int frameIndex = 0; frameIndex < FRAMES + 1; ++frameIndex)
+        {
+            glFinish();
+            Clock::time_point start = Clock::now();
+            objectUniforms.beginFrame();
+            if (mode == 0)
+            {
+                programChanges = materialChanges = 0;
+                unsigned int boundProgram = PROGRAMS, boundMaterial = MATERIALS;
+                for (const Placement& placement : placements)
+                {
+                    if (placement.program != boundProgram)
+                        programChanges++;
+                    if (placement.material != boundMaterial)
+                        materialChanges++;
+                    boundProgram = placement.program;
+                    boundMaterial = placement.material;
+                    programs[placement.program]->use();
+                    materials[placement.material]->bind();
+                    objectUniforms.pushAndBind(placement.object);
+                    pool.draw(meshes[placement.mesh]);
+                }
+            }
+            else
+            {
+                std::vector<std::unique_ptr<Shader>>& set = multiDraw ? multiDrawPrograms : programs;
+                queue.begin();
+                for (const Placement& placement : placements)
+                    queue.add(RENDER_PASS_MAIN, *set[placement.program], placement.material, meshes[placement.mesh],
+                        placement.object, RenderQueue::viewDistance(viewProjection, placement.position));
+                batch.begin();
+                queue.submit(objectUniforms, bindMaterial, multiDraw ? &batch : nullptr);
+                batch.end();
+                programChanges = queue.getStats().programChanges;
+                materialChanges = queue.getStats().materialChanges;
+            }
+            objectUniforms.endFrame();
+            Clock::time_point submitted = Clock::now();
+            glFinish();
+            // the first frame warms up driver state and is not counted
+            if (frameIndex > 0)
+            {
+                submitMs += std::chrono::duration<double, std::milli>(submitted - start).count();
+                frameMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+        }
+        std::cout << names[mode] << submitMs / FRAMES << " ms submit, " << frameMs / FRAMES << " ms frame, "
+            << programChanges << " program / " << materialChanges << " material changes" << std::endl;
+    }
+    for (std::unique_ptr<Shader>& program : programs)
+        glDeleteProgram(program->ID);
+    for (std::unique_ptr<Shader>& program : multiDrawPrograms)
+        glDeleteProgram(program->ID);
+}
+
+// Records one RenderQueue per view (frustum test, keys, sort) into command
+// lists on one thread and then across a JobSystem's workers, checks the
+// lists come out byte-identical and replays them on the context thread.
+// Views are tiles of the window looking at the same scene from around it.
+// ------------------------------------------------------------------------
+inline void RunCommandListBenchmark(unsigned int objectCount)
+{
+    const int FRAMES = 30;
+    const unsigned int VIEWS = 8, MESHES = 8;
+
+    GeometryPool pool;
+    GeometryHandle meshes[MESHES];
+    for (unsigned int m = 0; m < MESHES; ++m)
+    {
+        MeshData data = m % 2 == 0 ? MakeBox(Vec3(1.0f, 0.5f + 0.25f * m, 1.0f)) : MakeSphere(6 + 2 * m, 4 + m);
+        meshes[m] = pool.add(MeshData::layout(), data.vertices.data(), data.vertexCount(), data.indices);
+    }
+    Shader shader("res/shaders/VertexShader.shader", "res/shaders/FragmentShader.shader");
+
+    uint32_t seed = 5;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    struct Placement { GeometryHandle mesh; Vec4 sphere; ObjectBlock object; };
+    std::vector<Placement> placements(objectCount);
+    for (Placement& placement : placements)
+    {
+        Vec3 position(random() * 80.0f - 40.0f, random() * 20.0f - 10.0f, random() * 80.0f - 40.0f);
+        placement.mesh = meshes[(unsigned int)(random() * MESHES) % MESHES];
+        placement.sphere = Vec4(position, 0.4f);
+        placement.object.model = Mat4::translation(position) * Mat4::scale(Vec3(0.2f, 0.2f, 0.2f));
+        placement.object.color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const int tileWidth = std::max(viewport[2] / 4, 1), tileHeight = std::max(viewport[3] / 2, 1);
+    std::vector<FrameBlock> frames(VIEWS);
+    std::vector<CullViewBlock> views(VIEWS);
+    std::vector<std::unique_ptr<RenderQueue>> queues;
+    for (unsigned int v = 0; v < VIEWS; ++v)
+    {
+        float angle = 6.2831853f * v / VIEWS;
+        Vec3 eye(std::cos(angle) * 60.0f, 10.0f, std::sin(angle) * 60.0f);
+        frames[v].view = Mat4::lookAt(eye, Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+        frames[v].projection = Mat4::perspective(1.047f, (float)tileWidth / tileHeight, 0.5f, 200.0f);
+        frames[v].viewProjection = frames[v].projection * frames[v].view;
+        frames[v].time = Vec4(0.0f, 0.0f, 0.0f, 0.0f);
+        views[v] = CullViewBlock::fromMatrix(frames[v].viewProjection);
+        queues.emplace_back(new RenderQueue(pool));
+    }
+
+    // the part a worker does for its view: traversal, keys, sort, commands
+    std::vector<CommandRecorder::Task> tasks;
+    for (unsigned int v = 0; v < VIEWS; ++v)
+        tasks.push_back([&, v](CommandList& list)
+        {
+            RenderQueue& queue = *queues[v];
+            queue.begin();
+            for (const Placement& placement : placements)
+                if (CullSphere(placement.sphere, views[v], nullptr))
+                    queue.add(RENDER_PASS_MAIN, shader, 0, placement.mesh, placement.object,
+                        RenderQueue::viewDistance(frames[v].viewProjection, Vec3(placement.sphere.x, placement.sphere.y, placement.sphere.z)));
+            list.setViewport((int)(v % 4) * tileWidth, (int)(v / 4) * tileHeight, tileWidth, tileHeight);
+            list.uniformBlock(UNIFORM_BINDING_FRAME, frames[v]);
+            queue.record(list);
+        });
+
+    JobSystem jobs;
+    CommandRecorder serial, parallel(&jobs);
+    // one record pass to size the object ring for every visible draw
+    serial.record(tasks);
+    unsigned int drawCount = 0;
+    for (std::unique_ptr<RenderQueue>& queue : queues)
+        drawCount += queue->getDrawCount();
+    UniformRing frameUniforms(UNIFORM_BINDING_FRAME, VIEWS * 256);
+    UniformRing objectUniforms(UNIFORM_BINDING_OBJECT, std::max(drawCount, 1u) * 256);
+    CommandContext context;
+    context.pool = &pool;
+    context.frameUniforms = &frameUniforms;
+    context.objectUniforms = &objectUniforms;
+
+    std::cout << "Command list benchmark (" << objectCount << " objects, " << VIEWS << " views, " << drawCount << " draws, "
+        << parallel.getThreadCount() << " recording threads)" << std::endl;
+    typedef std::chrono::high_resolution_clock Clock;
+    CommandRecorder* recorders[2] = { &serial, &parallel };
+    const char* names[2] = { "  recorded serially:     ", "  recorded in parallel: " };
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        CommandRecorder& recorder = *recorders[mode];
+        double recordMs = 0.0, executeMs = 0.0;
+        for (int frameIndex = 0; frameIndex < FRAMES + 1; ++frameIndex)
+        {
+            glFinish();
+            Clock::time_point start = Clock::now();
+            recorder.record(tasks);
+            Clock::time_point recorded = Clock::now();
+            frameUniforms.beginFrame();
+            objectUniforms.beginFrame();
+            recorder.execute(context);
+            objectUniforms.endFrame();
+            frameUniforms.endFrame();
+            glFinish();
+            // the first frame warms up driver state and is not counted
+            if (frameIndex > 0)
+            {
+                recordMs += std::chrono::duration<double, std::milli>(recorded - start).count();
+                executeMs += std::chrono::duration<double, std::milli>(Clock::now() - recorded).count();
+            }
+        }
+        unsigned int commands = 0;
+        for (size_t i = 0; i < recorder.getListCount(); ++i)
+            commands += recorder.getList(i).getCommandCount();
+        std::cout << names[mode] << recordMs / FRAMES << " ms record, " << executeMs / FRAMES << " ms execute, "
+            << commands << " commands" << std::endl;
+    }
+
+    // same tasks, same order: the lists must not depend on the threads
+    bool identical = true;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        const CommandList& a = serial.getList(i);
+        const CommandList& b = parallel.getList(i);
+        identical = identical && a.getSize() == b.getSize() && memcmp(a.getData(), b.getData(), a.getSize()) == 0;
+    }
+    if (!identical)
+        std::cout << "ERROR::COMMAND_LIST_BENCHMARK::LISTS_DIFFER between serial and parallel recording" << std::endl;
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDeleteProgram(shader.ID);
+}
+
+// Per-frame transform update and frustum culling of objectCount objects on a
+// CommandRecorder on a JobSystem against the same tasks recorded serially:
+// batches of varying size back to back, each task vector destroyed as soon
+// as record() returns, so a worker still touching a finished batch or
+// claiming a task of the previous one shows up as a mismatch (or under a
+// sanitizer).
+// ------------------------------------------------------------------------
+inline bool VerifyCommandRecorder(unsigned int rounds)
+{
+    std::cout << "Command recorder self-check (" << rounds << " batches)" << std::endl;
+    JobSystem jobs(std::max(JobSystem::DefaultWorkerCount(), 3u));
+    CommandRecorder parallel(&jobs);
+    CommandRecorder serial;
+    unsigned int mismatches = 0;
+    for (unsigned int round = 0; round < rounds && mismatches == 0; ++round)
+    {
+        size_t taskCount = 1 + round % 17;
+        {
+            std::vector<CommandRecorder::Task> tasks;
+            for (size_t i = 0; i < taskCount; ++i)
+                tasks.push_back([round, i](CommandList& list)
+                {
+                    for (unsigned int c = 0; c < 1 + (round + i) % 5; ++c)
+                        list.setViewport((int)round, (int)i, (int)c, 1);
+                });
+            parallel.record(tasks);
+            serial.record(tasks);
+        }
+        bool same = parallel.getListCount() == taskCount && serial.getListCount() == taskCount;
+        for (size_t i = 0; same && i < taskCount; ++i)
+        {
+            const CommandList& a = parallel.getList(i);
+            const CommandList& b = serial.getList(i);
+            same = a.getSize() == b.getSize() && memcmp(a.getData(), b.getData(), a.getSize()) == 0;
+        }
+        if (!same)
+            mismatches++;
+    }
+    std::cout << "  " << jobs.getThreadCount() << " threads, parallel lists match serial ones: " << (mismatches ? "FAILED" : "OK") << std::endl;
+    return mismatches == 0;
+}
+
+// JobSystem with 1 to N threads: parallelFor over the transforms, then a
+// culling job that depends on them and splits itself again. Reports the
+// frame time and the speedup over one thread, and checks every thread
+// count finds the same visible set.
+// ------------------------------------------------------------------------
+inline void RunJobSystemBenchmark(unsigned int objectCount)
+{
+    const int FRAMES = 30;
+    uint32_t seed = 9;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24);
+    };
+    std::vector<Vec3> positions(objectCount);
+    for (Vec3& position : positions)
+        position = Vec3(random() * 200.0f - 100.0f, random() * 40.0f - 20.0f, random() * 200.0f - 100.0f);
+    std::vector<Mat4> models(objectCount);
+    std::vector<Vec4> spheres(objectCount);
+    std::vector<unsigned char> visible(objectCount);
+    CullViewBlock view = CullViewBlock::fromMatrix(Mat4::perspective(1.047f, 16.0f / 9.0f, 0.5f, 150.0f) *
+        Mat4::lookAt(Vec3(0.0f, 10.0f, 120.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)));
+
+    unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::cout << "Job system benchmark (" << objectCount << " objects, transforms + culling, up to "
+        << maxThreads << " threads)" << std::endl;
+    typedef std::chrono::high_resolution_clock Clock;
+    double singleMs = 0.0;
+    unsigned int expectedVisible = 0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1)
+    {
+        JobSystem jobs(threads - 1);
+        double totalMs = 0.0;
+        unsigned int visibleCount = 0;
+        for (int frameIndex = 0; frameIndex < FRAMES + 1; ++frameIndex)
+        {
+            float time = frameIndex * 0.016f;
+            std::atomic<unsigned int> frameVisible{ 0 };
+            Clock::time_point start = Clock::now();
+            JobCounter transformed, culled;
+            jobs.parallelFor(objectCount, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    float bob = std::sin(time * 2.0f + positions[i].x * 0.1f);
+                    Vec3 position(positions[i].x, positions[i].y + bob, positions[i].z);
+                    float size = 0.5f + 0.25f * std::cos(time + positions[i].z * 0.1f);
+                    models[i] = Mat4::translation(position) * Mat4::scale(Vec3(size, size, size));
+                    spheres[i] = Vec4(position, size * 1.7320508f);
+                }
+            }, &transformed);
+            jobs.run([&]()
+            {
+                jobs.parallelFor(objectCount, [&](size_t begin, size_t end)
+                {
+                    unsigned int count = 0;
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        visible[i] = CullSphere(spheres[i], view, nullptr) ? 1 : 0;
+                        count += visible[i];
+                    }
+                    frameVisible += count;
+                });
+            }, &culled, &transformed);
+            jobs.wait(culled);
+            // the first frame warms up the workers and is not counted
+            if (frameIndex > 0)
+                totalMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            visibleCount = frameVisible;
+        }
+        if (threads == 1)
+        {
+            singleMs = totalMs;
+            expectedVisible = visibleCount;
+        }
+        else if (visibleCount != expectedVisible)
+            std::cout << "ERROR::JOB_SYSTEM_BENCHMARK::VISIBLE_MISMATCH " << visibleCount << " != " << expectedVisible << std::endl;
+        std::cout << "  " << threads << " thread" << (threads > 1 ? "s: " : ":  ") << totalMs / FRAMES << " ms/frame, "
+            << singleMs / totalMs << "x, " << visibleCount << " visible" << std::endl;
+    }
+}
+
+// Fiber scheduler self-check, without workers and with three: tasks that
+// wait on their children, many tasks parked on one counter, counters that
+// are reused, and fiber reuse. Returns false on any failure.
+// ------------------------------------------------------------------------
+inline bool VerifyFiberScheduler()
+{
+    bool allPassed = true;
+    auto check = [&allPassed](bool passed, const char* name, unsigned int workers)
+    {
+        std::cout << "  " << name << " (" << workers << " workers): " << (passed ? "OK" : "FAILED") << std::endl;
+        allPassed = allPassed && passed;
+    };
+    std::cout << "Fiber scheduler self-check" << std::endl;
+    const unsigned int workerCounts[2] = { 0, 3 };
+    for (unsigned int workers : workerCounts)
+    {
+        FiberScheduler fibers(workers);
+
+        // a parent parks on its children, which park on theirs
+        {
+            const int CHILDREN = 32, GRANDCHILDREN = 8;
+            std::atomic<int> sum{ 0 };
+            bool parentSawAll = false;
+            FiberCounter parentDone;
+            fibers.run([&]()
+            {
+                FiberCounter children;
+                for (int c = 0; c < CHILDREN; ++c)
+                    fibers.run([&, c]()
+                    {
+                        FiberCounter grandchildren;
+                        for (int g = 0; g < GRANDCHILDREN; ++g)
+                        {
+                            int value = c * GRANDCHILDREN + g;
+                            fibers.run([&sum, value]() { sum += value; }, &grandchildren);
+                        }
+                        fibers.wait(grandchildren);
+                    }, &children);
+                fibers.wait(children);
+                parentSawAll = sum == (CHILDREN * GRANDCHILDREN - 1) * CHILDREN * GRANDCHILDREN / 2;
+            }, &parentDone);
+            fibers.wait(parentDone);
+            check(parentSawAll, "nested waits", workers);
+        }
+        // every task parked on a gate resumes after the gate's task, and only
+        // then; the gate's task is queued first, so the gate is closed before
+        // any waiter runs, and it opens only once all of them have started,
+        // so they really park (without workers, all do)
+        {
+            const int WAITERS = 200;
+            std::atomic<bool> gateOpen{ false };
+            std::atomic<int> started{ 0 }, resumedEarly{ 0 }, resumed{ 0 };
+            FiberCounter gate, waiters;
+            unsigned long long parksBefore = fibers.getParkCount();
+            fibers.run([&]()
+            {
+                while (started < WAITERS)
+                    fibers.yield();
+                gateOpen = true;
+            }, &gate);
+            for (int i = 0; i < WAITERS; ++i)
+                fibers.run([&]()
+                {
+                    started++;
+                    fibers.wait(gate);
+                    if (!gateOpen)
+                        resumedEarly++;
+                    resumed++;
+                }, &waiters);
+            fibers.wait(waiters);
+            unsigned long long parked = fibers.getParkCount() - parksBefore;
+            std::cout << "  " << parked << " of " << WAITERS << " waiters parked" << std::endl;
+            check(resumed == WAITERS && resumedEarly == 0 && parked > 0 && (workers > 0 || parked == (unsigned long long)WAITERS),
+                "parked on one counter", workers);
+        }
+        // one counter reused for consecutive batches; finished fibers are reused
+        {
+            FiberCounter batch;
+            std::atomic<int> ran{ 0 };
+            size_t fiberCount = fibers.getFiberCount();
+            for (int round = 0; round < 500; ++round)
+            {
+                for (int i = 0; i < 4; ++i)
+                    fibers.run([&ran]() { ran++; }, &batch);
+                fibers.wait(batch);
+            }
+            check(ran == 2000 && fibers.getFiberCount() == fiberCount, "counter and fiber reuse", workers);
+        }
+    }
+    return allPassed;
+}
+
+// Fiber scheduling overhead on the calling thread (no workers): a task that
+// yields back and forth, spawning and running empty tasks, and a task that
+// parks on a child and is resumed by it.
+// ------------------------------------------------------------------------
+inline void RunFiberBenchmark(unsigned int iterations)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    FiberScheduler fibers(0);
+    std::cout << "Fiber scheduler benchmark (" << iterations << " iterations, calling thread only)" << std::endl;
+
+    // each yield is two switches: to the scheduler and back
+    FiberCounter done;
+    fibers.run([&]()
+    {
+        for (unsigned int i = 0; i < iterations; ++i)
+            fibers.yield();
+    }, &done);
+    Clock::time_point start = Clock::now();
+    fibers.wait(done);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    std::cout << "  switch:          " << ns / (2.0 * iterations) << " ns" << std::endl;
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        fibers.run([]() {}, &done);
+    fibers.wait(done);
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    std::cout << "  run empty task:  " << ns / iterations << " ns" << std::endl;
+
+    fibers.run([&]()
+    {
+        for (unsigned int i = 0; i < iterations; ++i)
+        {
+            FiberCounter child;
+            fibers.run([]() {}, &child);
+            fibers.wait(child);
+        }
+    }, &done);
+    start = Clock::now();
+    fibers.wait(done);
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    std::cout << "  park on a child: " << ns / iterations << " ns (run, park, child, resume)" << std::endl;
+}
+
+#ifndef CROSSBEAM_SHIPPING
+// Cost of a profiler zone: an empty loop against the same loop with one
+// zone per iteration, draining every 10000 zones as a frame would.
+// ------------------------------------------------------------------------
+inline void RunProfilerBenchmark(unsigned int zoneCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const unsigned int ZONES_PER_FRAME = 10000;
+    volatile unsigned int sink = 0;
+    Profiler& profiler = Profiler::instance();
+    profiler.reset();
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < zoneCount; ++i)
+    {
+        sink = sink + 1;
+        if (i % ZONES_PER_FRAME == ZONES_PER_FRAME - 1)
+            profiler.endFrame();
+    }
+    double baseNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    profiler.reset();
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < zoneCount; ++i)
+    {
+        PROFILE_SCOPE("Benchmark zone");
+        sink = sink + 1;
+        if (i % ZONES_PER_FRAME == ZONES_PER_FRAME - 1)
+            profiler.endFrame();
+    }
+    double zoneNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    profiler.endFrame();
+
+    // a zone reads the clock twice; on some VMs that alone is tens of ns
+    uint64_t stamps = 0;
+    start = Clock::now();
+    for (unsigned int i = 0; i < zoneCount; ++i)
+        stamps += ProfileTimestamp();
+    double stampNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / zoneCount;
+    sink = sink + (unsigned int)(stamps & 1);
+
+    double perZone = (zoneNs - baseNs) / zoneCount;
+    std::cout << "Profiler benchmark (" << zoneCount << " zones, drained every " << ZONES_PER_FRAME << ")" << std::endl;
+    std::cout << "  " << perZone << " ns per zone, including the drain" << (perZone > 20.0 ? " (over the 20 ns budget)" : "") << std::endl;
+    std::cout << "  " << stampNs << " ns per timestamp, two per zone" << std::endl;
+    profiler.printSummary();
+    profiler.reset();
+}
+#endif
+
+// Input edges and action mapping on injected events (no window needed):
+// edges last exactly one update, a held key does not re-fire, an action
+// bound to two buttons presses once and releases with the last of them.
+// ------------------------------------------------------------------------
+inline bool VerifyInputSystem()
+{
+    bool allPassed = true;
+    auto check = [&allPassed](bool passed, const char* name)
+    {
+        std::cout << "  " << name << ": " << (passed ? "OK" : "FAILED") << std::endl;
+        allPassed = allPassed && passed;
+    };
+    std::cout << "Input system self-check" << std::endl;
+    const int ACTION_TOGGLE = 0, ACTION_FIRE = 1;
+    const int FIRE_MOUSE = MouseButtonCode(GLFW_MOUSE_BUTTON_LEFT);
+    InputSystem input;
+    input.bindAction(ACTION_TOGGLE, GLFW_KEY_F);
+    input.bindAction(ACTION_FIRE, GLFW_KEY_SPACE);
+    input.bindAction(ACTION_FIRE, FIRE_MOUSE);
+
+    // a key held for several frames toggles once
+    int toggles = 0;
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_F, GLFW_PRESS, 0);
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        input.update();
+        if (input.actionPressed(ACTION_TOGGLE))
+            toggles++;
+    }
+    check(toggles == 1 && input.isDown(GLFW_KEY_F) && !input.wasPressed(GLFW_KEY_F), "held key fires once");
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_F, GLFW_RELEASE, 0);
+    input.update();
+    bool released = input.wasReleased(GLFW_KEY_F) && input.actionReleased(ACTION_TOGGLE) && !input.isDown(GLFW_KEY_F);
+    input.update();
+    check(released && !input.wasReleased(GLFW_KEY_F) && !input.actionReleased(ACTION_TOGGLE), "release edge lasts one update");
+
+    // press and release between two updates still reports both edges
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_F, GLFW_PRESS, 0);
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_F, GLFW_RELEASE, 0);
+    input.update();
+    check(input.actionPressed(ACTION_TOGGLE) && input.actionReleased(ACTION_TOGGLE) && !input.actionDown(ACTION_TOGGLE),
+        "tap within one frame");
+
+    // two bindings: pressed with the first, released with the last
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_SPACE, GLFW_PRESS, 0);
+    input.update();
+    bool firstDown = input.actionPressed(ACTION_FIRE);
+    input.push(INPUT_EVENT_BUTTON, FIRE_MOUSE, GLFW_PRESS, 0);
+    input.update();
+    bool secondDown = !input.actionPressed(ACTION_FIRE) && input.actionDown(ACTION_FIRE) && input.wasPressed(FIRE_MOUSE);
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_SPACE, GLFW_RELEASE, 0);
+    input.update();
+    bool firstUp = !input.actionReleased(ACTION_FIRE) && input.actionDown(ACTION_FIRE);
+    input.push(INPUT_EVENT_BUTTON, FIRE_MOUSE, GLFW_RELEASE, 0);
+    input.update();
+    check(firstDown && secondDown && firstUp && input.actionReleased(ACTION_FIRE) && !input.actionDown(ACTION_FIRE),
+        "action with two bindings");
+
+    // text and cursor events pass through in order, timestamped
+    input.push(INPUT_EVENT_CHAR, 'h', 0, 0);
+    input.push(INPUT_EVENT_CURSOR, 0, 0, 0, 12.0, 34.0);
+    input.push(INPUT_EVENT_CHAR, 'i', 0, 0);
+    input.update();
+    const std::vector<InputEvent>& events = input.getEvents();
+    check(input.getText().size() == 2 && input.getText()[0] == 'h' && input.getText()[1] == 'i' && input.getCursorX() == 12.0 &&
+        input.getCursorY() == 34.0 && events.size() == 3 && events[0].timestamp <= events[2].timestamp, "text and cursor");
+
+    // a full queue drops events instead of overwriting unread ones; cursor
+    // events leave the reserve to buttons, so a release after a flood of
+    // them still arrives
+    const uint32_t CURSOR_SLOTS = InputQueue::CAPACITY - InputQueue::BUTTON_RESERVE;
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_SPACE, GLFW_PRESS, 0);
+    input.update();
+    for (uint32_t i = 0; i < InputQueue::CAPACITY + 10; ++i)
+        input.push(INPUT_EVENT_CURSOR, 0, 0, 0, (double)i, 0.0);
+    input.push(INPUT_EVENT_BUTTON, GLFW_KEY_SPACE, GLFW_RELEASE, 0);
+    input.update();
+    check(input.getDroppedEvents() == InputQueue::CAPACITY + 10 - CURSOR_SLOTS && input.getEvents().size() == CURSOR_SLOTS + 1 &&
+        input.getCursorX() == (double)(CURSOR_SLOTS - 1), "queue overflow");
+    check(input.wasReleased(GLFW_KEY_SPACE) && !input.isDown(GLFW_KEY_SPACE) && !input.actionDown(ACTION_FIRE),
+        "release after a cursor flood");
+    return allPassed;
+}
+
+// Redundant state filtering counts: binding the same texture twice reaches
+// GL once and is filtered once.
+// ------------------------------------------------------------------------
+inline bool VerifyGLStateCache()
+{
+    std::cout << "GL state cache self-check" << std::endl;
+    GLStateCache& state = GLStateCache::instance();
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    // unit 0 selected and unbound first, so only the two binds are counted
+    state.invalidate();
+    state.bindTexture(0, GL_TEXTURE_2D, 0);
+    GLStateCache::Counters before = state.counters();
+    state.bindTexture(0, GL_TEXTURE_2D, texture);
+    state.bindTexture(0, GL_TEXTURE_2D, texture);
+    unsigned long long issued = state.counters().issued - before.issued;
+    unsigned long long filtered = state.counters().filtered - before.filtered;
+    state.bindTexture(0, GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture);
+    bool passed = issued == 1 && filtered == 1;
+    std::cout << "  same texture twice: " << issued << " issued, " << filtered << " filtered: " << (passed ? "OK" : "FAILED") << std::endl;
+    return passed;
+}
+#endif
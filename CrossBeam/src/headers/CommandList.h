@@ -0,0 +1,319 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#include "Math.h"
+#include "BasicShader.h"
+#include "GeometryPool.h"
+#include "MultiDraw.h"
+#include "UniformBuffer.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
+
+// What a CommandList replays into; everything is owned by the context thread
+// ------------------------------------------------------------------------
+struct CommandContext
+{
+    GeometryPool* pool = nullptr;
+    UniformRing* frameUniforms = nullptr;
+    UniformRing* objectUniforms = nullptr;
+    std::function<void(unsigned int)> bindMaterial;
+    // when set, the draws between flushes become one multi-draw each
+    // (MULTI_DRAW programs, the batch between begin() and end())
+    MultiDrawBatch* batch = nullptr;
+};
+
+// Backend-agnostic list of render commands in one block of linear memory.
+// Recording only copies bytes and never touches GL, so any thread can fill
+// its own list; execute() then replays it on the thread that owns the
+// context. Programs are referenced by Shader*, meshes by GeometryHandle and
+// materials by index; uniform data is copied into the list.
+//
+//     list.reset();
+//     list.setViewport(0, 0, width, height);
+//     list.uniformBlock(UNIFORM_BINDING_FRAME, frame);
+//     list.useProgram(shader);
+//     list.bindMaterial(material);
+//     list.draw(mesh, object);
+//     list.flush();              // end of a run of draws with the same state
+//     ...
+//     list.execute(context);     // context thread only
+//
+// Shaders must already exist when recording, fetch ShaderVariants on the
+// context thread first.
+// ------------------------------------------------------------------------
+class CommandList
+{
+public:
+    enum CommandType : uint32_t
+    {
+        COMMAND_VIEWPORT,
+        COMMAND_CLEAR,
+        COMMAND_USE_PROGRAM,
+        COMMAND_BIND_MATERIAL,
+        COMMAND_BLENDING,
+        COMMAND_UNIFORM_BLOCK,
+        COMMAND_DRAW,
+        COMMAND_FLUSH,
+    };
+
+    // forget the recorded commands, keeping the memory
+    // ------------------------------------------------------------------------
+    void reset()
+    {
+        head = 0;
+        commandCount = 0;
+    }
+    // ------------------------------------------------------------------------
+    void setViewport(int x, int y, int width, int height)
+    {
+        int32_t* viewport = (int32_t*)push(COMMAND_VIEWPORT, 4 * sizeof(int32_t));
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+    }
+    // ------------------------------------------------------------------------
+    void clear(GLbitfield mask, const Vec4& color = Vec4(0.0f, 0.0f, 0.0f, 1.0f))
+    {
+        Clear* command = (Clear*)push(COMMAND_CLEAR, sizeof(Clear));
+        command->mask = mask;
+        command->color = color;
+    }
+    // ------------------------------------------------------------------------
+    void useProgram(Shader& shader)
+    {
+        Shader* program = &shader;
+        memcpy(push(COMMAND_USE_PROGRAM, sizeof(Shader*)), &program, sizeof(Shader*));
+    }
+    // ------------------------------------------------------------------------
+    void bindMaterial(unsigned int material)
+    {
+        uint32_t value = material;
+        memcpy(push(COMMAND_BIND_MATERIAL, sizeof(value)), &value, sizeof(value));
+    }
+    // alpha blending without depth writes, for translucent draws
+    // ------------------------------------------------------------------------
+    void setBlending(bool enabled)
+    {
+        uint32_t value = enabled ? 1 : 0;
+        memcpy(push(COMMAND_BLENDING, sizeof(value)), &value, sizeof(value));
+    }
+    // copy a uniform block in; it is pushed and bound through the context's
+    // ring for that binding (frame or object) when the list executes
+    // ------------------------------------------------------------------------
+    template <typename T>
+    void uniformBlock(unsigned int binding, const T& block)
+    {
+        unsigned char* data = push(COMMAND_UNIFORM_BLOCK, sizeof(uint32_t) * 2 + sizeof(T));
+        uint32_t header[2] = { binding, (uint32_t)sizeof(T) };
+        memcpy(data, header, sizeof(header));
+        memcpy(data + sizeof(header), &block, sizeof(T));
+    }
+    // a draw and the record it reads as its object block
+    // ------------------------------------------------------------------------
+    void draw(GeometryHandle mesh, const ObjectBlock& object)
+    {
+        Draw* command = (Draw*)push(COMMAND_DRAW, sizeof(Draw));
+        command->mesh = mesh;
+        command->object = object;
+    }
+    // the draws since the last flush may merge into one multi-draw
+    // ------------------------------------------------------------------------
+    void flush()
+    {
+        push(COMMAND_FLUSH, 0);
+    }
+    // replay on the context thread
+    // ------------------------------------------------------------------------
+    void execute(CommandContext& context) const
+    {
+        GLStateCache& state = GLStateCache::instance();
+        unsigned int pending = 0;
+        size_t offset = 0;
+        while (offset < head)
+        {
+            const Header* header = (const Header*)(memory.data() + offset);
+            const unsigned char* data = memory.data() + offset + sizeof(Header);
+            offset += sizeof(Header) + header->size;
+            // a pending multi-draw goes out before any state changes
+            if (pending > 0 && header->type != COMMAND_DRAW)
+            {
+                context.batch->submit();
+                pending = 0;
+            }
+            switch (header->type)
+            {
+            case COMMAND_VIEWPORT:
+            {
+                const int32_t* viewport = (const int32_t*)data;
+                glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+                break;
+            }
+            case COMMAND_CLEAR:
+            {
+                const Clear* command = (const Clear*)data;
+                state.clearColor(command->color.x, command->color.y, command->color.z, command->color.w);
+                glClear(command->mask);
+                break;
+            }
+            case COMMAND_USE_PROGRAM:
+            {
+                Shader* program;
+                memcpy(&program, data, sizeof(Shader*));
+                program->use();
+                break;
+            }
+            case COMMAND_BIND_MATERIAL:
+                if (context.bindMaterial)
+                    context.bindMaterial(*(const uint32_t*)data);
+                break;
+            case COMMAND_BLENDING:
+            {
+                bool enabled = *(const uint32_t*)data != 0;
+                state.setEnabled(GL_BLEND, enabled);
+                if (enabled)
+                    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                state.depthMask(!enabled);
+                break;
+            }
+            case COMMAND_UNIFORM_BLOCK:
+            {
+                const uint32_t* block = (const uint32_t*)data;
+                UniformRing* ring = block[0] == UNIFORM_BINDING_FRAME ? context.frameUniforms
+                    : block[0] == UNIFORM_BINDING_OBJECT ? context.objectUniforms : nullptr;
+                if (!ring)
+                {
+                    std::cout << "ERROR::COMMAND_LIST::NO_RING_FOR_BINDING " << block[0] << std::endl;
+                    break;
+                }
+                ring->bind(ring->push(block + 2, block[1]), block[1]);
+                break;
+            }
+            case COMMAND_DRAW:
+            {
+                const Draw* command = (const Draw*)data;
+                if (context.batch)
+                {
+                    context.batch->add(command->mesh, command->object);
+                    pending++;
+                }
+                else
+                {
+                    context.objectUniforms->pushAndBind(command->object);
+                    context.pool->draw(command->mesh);
+                }
+                break;
+            }
+            case COMMAND_FLUSH:
+                break;
+            }
+        }
+        if (pending > 0)
+            context.batch->submit();
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getCommandCount() const { return commandCount; }
+    size_t getSize() const { return head; }
+    const unsigned char* getData() const { return memory.data(); }
+
+private:
+    struct Header
+    {
+        uint32_t type;
+        // payload bytes that follow, a multiple of 8
+        uint32_t size;
+    };
+    struct Clear
+    {
+        Vec4 color;
+        GLbitfield mask;
+    };
+    struct Draw
+    {
+        ObjectBlock object;
+        GeometryHandle mesh;
+    };
+
+    std::vector<unsigned char> memory;
+    size_t head = 0;
+    unsigned int commandCount = 0;
+
+    // append a command and return its payload; payloads stay 8-byte aligned
+    unsigned char* push(CommandType type, size_t size)
+    {
+        size_t padded = (size + 7) & ~(size_t)7;
+        size_t needed = head + sizeof(Header) + padded;
+        if (needed > memory.size())
+            memory.resize(std::max(needed, memory.size() * 2));
+        Header* header = (Header*)(memory.data() + head);
+        header->type = type;
+        header->size = (uint32_t)padded;
+        unsigned char* data = memory.data() + head + sizeof(Header);
+        head = needed;
+        commandCount++;
+        return data;
+    }
+};
+
+// Records command lists on a JobSystem's workers and executes them on the
+// calling (context) thread in task order, so the result does not depend on
+// which worker finished first. The calling thread records too while it
+// waits. Without a JobSystem the tasks run one after another.
+//
+//     recorder.record(tasks);      // tasks[i] fills list i, in parallel
+//     recorder.execute(context);   // list 0, 1, ... on this thread
+// ------------------------------------------------------------------------
+class CommandRecorder
+{
+public:
+    typedef std::function<void(CommandList&)> Task;
+
+    CommandRecorder(JobSystem* jobs = nullptr) : jobs(jobs) {}
+
+    // run every task, each into its own reset list; returns once all are recorded
+    // ------------------------------------------------------------------------
+    void record(const std::vector<Task>& tasks)
+    {
+        if (lists.size() < tasks.size())
+            lists.resize(tasks.size());
+        listCount = tasks.size();
+        auto recordRange = [this, &tasks](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                lists[i].reset();
+                tasks[i](lists[i]);
+            }
+        };
+        if (jobs)
+            jobs->parallelFor(tasks.size(), recordRange, nullptr, 1);
+        else
+            recordRange(0, tasks.size());
+    }
+    // replay the lists of the last record() in task order
+    // ------------------------------------------------------------------------
+    void execute(CommandContext& context) const
+    {
+        for (size_t i = 0; i < listCount; ++i)
+            lists[i].execute(context);
+    }
+    // ------------------------------------------------------------------------
+    const CommandList& getList(size_t index) const { return lists[index]; }
+    size_t getListCount() const { return listCount; }
+    unsigned int getThreadCount() const { return jobs ? jobs->getThreadCount() : 1; }
+
+private:
+    JobSystem* jobs;
+    std::vector<CommandList> lists;
+    size_t listCount = 0;
+};
+#endif
@@ -0,0 +1,465 @@
+#ifndef FIBER_SCHEDULER_H
+#define FIBER_SCHEDULER_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <iostream>
+#include <functional>
+#include <condition_variable>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+struct Fiber;
+
+// Counts unfinished fiber tasks. Unlike JobCounter, waiting on it from a
+// task parks the task's fiber instead of the thread; the fibers parked on
+// it are queued again by whoever brings it to zero.
+// ------------------------------------------------------------------------
+class FiberCounter
+{
+public:
+    FiberCounter() = default;
+    FiberCounter(const FiberCounter&) = delete;
+    FiberCounter& operator=(const FiberCounter&) = delete;
+
+    // true once the last task has also let go of the counter
+    bool isDone()
+    {
+        if (pending.load(std::memory_order_acquire) != 0)
+            return false;
+        std::lock_guard<std::mutex> guard(lock);
+        return pending.load(std::memory_order_relaxed) == 0;
+    }
+
+private:
+    friend class FiberScheduler;
+    std::atomic<int> pending{ 0 };
+    std::mutex lock;
+    std::vector<Fiber*> waiters;
+};
+
+// A task's stack: Windows fibers, ucontext elsewhere. Tasks only get a
+// fiber when they start, and fibers go back to a pool when theirs returns.
+// ucontext stacks are mapped with an inaccessible guard page below them, so
+// an overflow faults instead of running into the next stack (Windows
+// fibers have one already).
+// ------------------------------------------------------------------------
+struct Fiber
+{
+    std::function<void()> task;
+    FiberCounter* counter = nullptr;
+#ifdef _WIN32
+    void* handle = nullptr;
+#else
+    ucontext_t context;
+    // guard page included
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+#endif
+};
+
+// Runs tasks on fibers over a fixed pool of worker threads. A task that
+// waits on a FiberCounter is parked and its thread picks up other work;
+// the task resumes (maybe on another thread) once the counter reaches
+// zero. Threads outside the pool help instead: wait() runs ready tasks on
+// the calling thread until the counter is done, and poll() runs what is
+// ready now, which is how the frame loop keeps tasks moving without
+// blocking on them.
+//
+//     FiberCounter decoded;
+//     fibers.run([&]() { mesh = Decode(file); }, &decoded);
+//     fibers.wait(decoded);       // in a task: parks; elsewhere: helps
+//
+// Tasks must not touch the GL context and must not hold a mutex across a
+// wait() or yield().
+// ------------------------------------------------------------------------
+class FiberScheduler
+{
+public:
+    FiberScheduler(unsigned int workerCount = DefaultWorkerCount(), size_t stackSize = 64 * 1024)
+        : stackSize(stackSize)
+    {
+        for (unsigned int i = 0; i < workerCount; ++i)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+    // ------------------------------------------------------------------------
+    ~FiberScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(readyLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        // tasks still parked or queued are dropped
+        for (Fiber* fiber : allFibers)
+            destroyFiber(fiber);
+        leaveThread();
+    }
+    FiberScheduler(const FiberScheduler&) = delete;
+    FiberScheduler& operator=(const FiberScheduler&) = delete;
+
+    // ------------------------------------------------------------------------
+    static unsigned int DefaultWorkerCount()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+    // queue a task; any thread, including tasks
+    // ------------------------------------------------------------------------
+    void run(std::function<void()> task, FiberCounter* counter = nullptr)
+    {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(readyLock);
+            tasks.push_back(Task{ std::move(task), counter });
+        }
+        wake.notify_one();
+    }
+    // inside a task: park until the counter is done; elsewhere: run ready
+    // tasks on this thread until it is
+    // ------------------------------------------------------------------------
+    void wait(FiberCounter& counter)
+    {
+        if (counter.isDone())
+            return;
+        if (threadState().current)
+        {
+            switchOut(SWITCH_PARK, &counter);
+            return;
+        }
+        while (!counter.isDone())
+            if (!runOne())
+                std::this_thread::yield();
+    }
+    // inside a task: let every resumed fiber and queued task run first
+    // ------------------------------------------------------------------------
+    void yield()
+    {
+        if (threadState().current)
+            switchOut(SWITCH_YIELD, nullptr);
+    }
+    // run the tasks that are ready now on this thread (not from a task);
+    // returns how many ran until they finished or parked
+    // ------------------------------------------------------------------------
+    unsigned int poll(unsigned int maxTasks = ~0u)
+    {
+        unsigned int ran = 0;
+        while (ran < maxTasks && runOne())
+            ran++;
+        return ran;
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getWorkerCount() const { return (unsigned int)workers.size(); }
+    size_t getFiberCount()
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        return allFibers.size();
+    }
+    // waits that parked their fiber (rather than finding the counter done)
+    unsigned long long getParkCount() const { return parks.load(std::memory_order_relaxed); }
+
+private:
+    enum SwitchReason
+    {
+        SWITCH_FINISHED,
+        SWITCH_PARK,
+        SWITCH_YIELD,
+    };
+    // per thread: where fibers switch back to and why they did
+    struct ThreadState
+    {
+        Fiber* current = nullptr;
+        SwitchReason reason = SWITCH_FINISHED;
+        FiberCounter* parkedOn = nullptr;
+#ifdef _WIN32
+        void* schedulerFiber = nullptr;
+        bool convertedThread = false;
+#else
+        ucontext_t schedulerContext;
+#endif
+    };
+
+    struct Task
+    {
+        std::function<void()> function;
+        FiberCounter* counter;
+    };
+
+    size_t stackSize;
+    std::vector<std::thread> workers;
+    std::mutex readyLock;
+    std::condition_variable wake;
+    // parked fibers whose counter is done go before new tasks, which keeps
+    // the number of fibers alive down; yielded fibers go after both, or a
+    // task yielding until others have started would keep them from starting
+    std::deque<Fiber*> ready;
+    std::deque<Task> tasks;
+    std::deque<Fiber*> yielded;
+    bool stopping = false;
+    std::mutex poolLock;
+    std::vector<Fiber*> freeFibers;
+    std::vector<Fiber*> allFibers;
+    std::atomic<unsigned long long> parks{ 0 };
+
+    // not inlined: a fiber can resume on another thread, its thread-local
+    // state must be looked up again after every switch
+#ifdef _MSC_VER
+    __declspec(noinline)
+#else
+    __attribute__((noinline))
+#endif
+    static ThreadState& threadState()
+    {
+        static thread_local ThreadState state;
+        return state;
+    }
+    // ------------------------------------------------------------------------
+    void makeReady(Fiber* fiber, bool yielding = false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(readyLock);
+            (yielding ? yielded : ready).push_back(fiber);
+        }
+        wake.notify_one();
+    }
+    // resume the next ready fiber on this thread until it switches back
+    // ------------------------------------------------------------------------
+    bool runOne()
+    {
+        Fiber* fiber = nullptr;
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(readyLock);
+            if (!ready.empty())
+            {
+                fiber = ready.front();
+                ready.pop_front();
+            }
+            else if (!tasks.empty())
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            else if (!yielded.empty())
+            {
+                fiber = yielded.front();
+                yielded.pop_front();
+            }
+            else
+                return false;
+        }
+        if (!fiber)
+        {
+            fiber = acquireFiber();
+            fiber->task = std::move(task.function);
+            fiber->counter = task.counter;
+        }
+        ThreadState& state = threadState();
+        state.current = fiber;
+#ifdef _WIN32
+        if (!state.schedulerFiber)
+        {
+            state.convertedThread = !IsThreadAFiber();
+            state.schedulerFiber = state.convertedThread ? ConvertThreadToFiber(nullptr) : GetCurrentFiber();
+        }
+        SwitchToFiber(fiber->handle);
+#else
+        swapcontext(&state.schedulerContext, &fiber->context);
+#endif
+        afterSwitch(threadState());
+        return true;
+    }
+    // what the fiber asked for, done once it is off its stack so no other
+    // thread can resume it while it still runs
+    // ------------------------------------------------------------------------
+    void afterSwitch(ThreadState& state)
+    {
+        Fiber* fiber = state.current;
+        state.current = nullptr;
+        if (state.reason == SWITCH_YIELD)
+            makeReady(fiber, true);
+        else if (state.reason == SWITCH_PARK)
+        {
+            FiberCounter* counter = state.parkedOn;
+            bool resume;
+            {
+                std::lock_guard<std::mutex> lock(counter->lock);
+                resume = counter->pending.load(std::memory_order_relaxed) == 0;
+                if (!resume)
+                    counter->waiters.push_back(fiber);
+            }
+            if (resume)
+                makeReady(fiber);
+            else
+                parks.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            FiberCounter* counter = fiber->counter;
+            fiber->task = nullptr;
+            fiber->counter = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(poolLock);
+                freeFibers.push_back(fiber);
+            }
+            if (counter)
+                release(*counter);
+        }
+    }
+    // a task finished; at zero its counter's waiters become ready
+    // ------------------------------------------------------------------------
+    void release(FiberCounter& counter)
+    {
+        std::vector<Fiber*> resumed;
+        {
+            std::lock_guard<std::mutex> lock(counter.lock);
+            if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                resumed.swap(counter.waiters);
+        }
+        for (Fiber* fiber : resumed)
+            makeReady(fiber);
+    }
+    // from a task: back to the thread's scheduler, which acts on the reason
+    // ------------------------------------------------------------------------
+    void switchOut(SwitchReason reason, FiberCounter* counter)
+    {
+        ThreadState& state = threadState();
+        state.reason = reason;
+        state.parkedOn = counter;
+        Fiber* fiber = state.current;
+#ifdef _WIN32
+        (void)fiber;
+        SwitchToFiber(state.schedulerFiber);
+#else
+        swapcontext(&fiber->context, &state.schedulerContext);
+#endif
+    }
+    // ------------------------------------------------------------------------
+    Fiber* acquireFiber()
+    {
+        {
+            std::lock_guard<std::mutex> lock(poolLock);
+            if (!freeFibers.empty())
+            {
+                Fiber* fiber = freeFibers.back();
+                freeFibers.pop_back();
+                return fiber;
+            }
+        }
+        Fiber* fiber = new Fiber();
+        FiberStart* start = new FiberStart{ this, fiber };
+#ifdef _WIN32
+        fiber->handle = CreateFiber(stackSize, &FiberScheduler::fiberMain, start);
+        if (!fiber->handle)
+            std::cout << "ERROR::FIBER_SCHEDULER::CREATE_FIBER_FAILED " << GetLastError() << std::endl;
+#else
+        // stacks grow down: the guard page goes at the low end
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t usable = (stackSize + page - 1) / page * page;
+        fiber->mappingSize = usable + page;
+        fiber->mapping = mmap(nullptr, fiber->mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (fiber->mapping == MAP_FAILED || mprotect(fiber->mapping, page, PROT_NONE) != 0)
+            std::cout << "ERROR::FIBER_SCHEDULER::STACK_MAP_FAILED " << fiber->mappingSize << " bytes" << std::endl;
+        getcontext(&fiber->context);
+        fiber->context.uc_stack.ss_sp = (char*)fiber->mapping + page;
+        fiber->context.uc_stack.ss_size = usable;
+        fiber->context.uc_link = nullptr;
+        // makecontext only passes ints: the pointer goes in two 32-bit halves,
+        // split in 64 bits so the high half is simply 0 where pointers are 32-bit
+        uint64_t address = (uint64_t)(uintptr_t)start;
+        makecontext(&fiber->context, (void (*)())&FiberScheduler::fiberEntry, 2, (unsigned int)(address >> 32), (unsigned int)address);
+#endif
+        std::lock_guard<std::mutex> lock(poolLock);
+        allFibers.push_back(fiber);
+        return fiber;
+    }
+    // ------------------------------------------------------------------------
+    void destroyFiber(Fiber* fiber)
+    {
+#ifdef _WIN32
+        if (fiber->handle)
+            DeleteFiber(fiber->handle);
+#else
+        if (fiber->mapping && fiber->mapping != MAP_FAILED)
+            munmap(fiber->mapping, fiber->mappingSize);
+#endif
+        delete fiber;
+    }
+    // ------------------------------------------------------------------------
+    void leaveThread()
+    {
+#ifdef _WIN32
+        ThreadState& state = threadState();
+        if (state.convertedThread)
+            ConvertFiberToThread();
+        state.schedulerFiber = nullptr;
+        state.convertedThread = false;
+#endif
+    }
+
+    struct FiberStart
+    {
+        FiberScheduler* scheduler;
+        Fiber* fiber;
+    };
+#ifdef _WIN32
+    static void WINAPI fiberMain(void* argument)
+    {
+        fiberLoop((FiberStart*)argument);
+    }
+#else
+    static void fiberEntry(unsigned int high, unsigned int low)
+    {
+        static_assert(sizeof(void*) <= sizeof(uint64_t), "pointers must fit the two halves");
+        fiberLoop((FiberStart*)(uintptr_t)(((uint64_t)high << 32) | (uint64_t)low));
+    }
+#endif
+    // a fiber runs one task per resume and never returns
+    // ------------------------------------------------------------------------
+    static void fiberLoop(FiberStart* start)
+    {
+        FiberScheduler* scheduler = start->scheduler;
+        Fiber* fiber = start->fiber;
+        delete start;
+        for (;;)
+        {
+            fiber->task();
+            scheduler->switchOut(SWITCH_FINISHED, nullptr);
+        }
+    }
+    // ------------------------------------------------------------------------
+    void workerLoop()
+    {
+        for (;;)
+        {
+            if (runOne())
+                continue;
+            std::unique_lock<std::mutex> lock(readyLock);
+            wake.wait(lock, [this]() { return stopping || !ready.empty() || !tasks.empty() || !yielded.empty(); });
+            if (stopping)
+                break;
+        }
+        leaveThread();
+    }
+};
+#endif
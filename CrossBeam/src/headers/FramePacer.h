@@ -0,0 +1,201 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+// how buffer swaps wait for the display
+enum SwapMode
+{
+    SWAP_IMMEDIATE,
+    // one swap per vertical blank
+    SWAP_VSYNC,
+    // vsync, but a late frame swaps at once (tears) instead of waiting a whole
+    // blank; plain vsync where the driver has no tear control
+    SWAP_ADAPTIVE
+};
+
+// Frame scheduler for the render loop:
+//
+//     frames in flight   at most N frames are queued on the GPU; the CPU
+//                        waits on the fence of frame i - N before frame i
+//     frame cap          optional, sleeps out the rest of the frame, then
+//                        spins the last stretch the OS sleep cannot hit
+//     fixed timestep     the simulation advances in steps of a fixed size;
+//                        getAlpha() places the rendered frame between the
+//                        last two steps for interpolation
+//
+// beginFrame() does the waiting, so call it right before sampling input:
+// input is then as fresh as possible when the frame is built.
+//
+//     FramePacer pacer(settings);
+//     pacer.applySwapMode();              // with the window's context current
+//     while (running)
+//     {
+//         pacer.beginFrame();
+//         glfwPollEvents();
+//         for (unsigned int i = 0; i < pacer.getSteps(); ++i)
+//             Simulate(pacer.getFixedStep());
+//         Render(pacer.getAlpha());
+//         glfwSwapBuffers(window);
+//         pacer.endFrame();
+//     }
+// ------------------------------------------------------------------------
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Settings
+    {
+        SwapMode swapMode = SWAP_VSYNC;
+        // frames per second, 0 leaves pacing to the swap mode
+        double targetFps = 0.0;
+        // simulation step in seconds
+        double fixedStep = 1.0 / 60.0;
+        // steps per frame at most; time beyond that is dropped after a hitch
+        // rather than caught up (which would make the next frame slower still)
+        unsigned int maxSteps = 8;
+        unsigned int maxFramesInFlight = 2;
+        // exactly one step per frame whatever the clock says, for headless
+        // runs that must render the same images every time
+        bool lockstep = false;
+    };
+
+    explicit FramePacer(const Settings& settings) : settings(settings),
+        fences(std::max(settings.maxFramesInFlight, 1u), (GLsync)0), startTime(Clock::now()), lastFrameTime(startTime)
+    {
+        if (this->settings.fixedStep <= 0.0)
+            this->settings.fixedStep = 1.0 / 60.0;
+    }
+    // ------------------------------------------------------------------------
+    ~FramePacer()
+    {
+        for (GLsync fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+    }
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // set the swap interval of the current context (windowed runs only)
+    // ------------------------------------------------------------------------
+    void applySwapMode() const
+    {
+        int interval = settings.swapMode == SWAP_IMMEDIATE ? 0 : 1;
+        if (settings.swapMode == SWAP_ADAPTIVE)
+        {
+            if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+                interval = -1;
+            else
+                std::cout << "FramePacer: no swap tear control, adaptive vsync falls back to vsync" << std::endl;
+        }
+        glfwSwapInterval(interval);
+    }
+    // wait for a free frame slot and the frame cap, then advance the clocks
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        waitForSlot();
+        if (settings.targetFps > 0.0)
+            sleepUntil(lastFrameTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.targetFps)));
+
+        Clock::time_point now = Clock::now();
+        delta = frameCount ? std::chrono::duration<double>(now - lastFrameTime).count() : 0.0;
+        lastFrameTime = now;
+        frameCount++;
+
+        accumulator += settings.lockstep ? settings.fixedStep : std::min(delta, settings.fixedStep * settings.maxSteps);
+        steps = 0;
+        while (accumulator >= settings.fixedStep)
+        {
+            accumulator -= settings.fixedStep;
+            steps++;
+        }
+    }
+    // fence the frame's commands; call after the swap
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        GLsync& fence = fences[(frameCount - 1) % fences.size()];
+        if (fence)
+            glDeleteSync(fence);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // simulation steps to run this frame
+    // ------------------------------------------------------------------------
+    unsigned int getSteps() const { return steps; }
+    double getFixedStep() const { return settings.fixedStep; }
+    // how far past the last step the frame is, 0..1
+    double getAlpha() const { return accumulator / settings.fixedStep; }
+    // seconds since the previous beginFrame(), 0 on the first frame
+    double getDelta() const { return delta; }
+    double getTime() const { return std::chrono::duration<double>(lastFrameTime - startTime).count(); }
+    const Settings& getSettings() const { return settings; }
+    // frames that had to wait for the GPU, and the milliseconds spent
+    unsigned long long getFenceWaits() const { return fenceWaits; }
+    double getFenceWaitMs() const { return fenceWaitMs; }
+
+private:
+    Settings settings;
+    std::vector<GLsync> fences;
+    Clock::time_point startTime;
+    Clock::time_point lastFrameTime;
+    unsigned long long frameCount = 0;
+    double delta = 0.0;
+    double accumulator = 0.0;
+    unsigned int steps = 0;
+    unsigned long long fenceWaits = 0;
+    double fenceWaitMs = 0.0;
+    // how late sleep_for wakes up, tracked so the spin covers it
+    double sleepErrorSeconds = 0.001;
+
+    // the slot of frame i was last used by frame i - maxFramesInFlight
+    // ------------------------------------------------------------------------
+    void waitForSlot()
+    {
+        GLsync& fence = fences[frameCount % fences.size()];
+        if (!fence)
+            return;
+        if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            Clock::time_point begin = Clock::now();
+            GLenum result;
+            do
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            while (result == GL_TIMEOUT_EXPIRED);
+            if (result == GL_WAIT_FAILED)
+                std::cout << "ERROR::FRAME_PACER::WAIT_FAILED" << std::endl;
+            fenceWaits++;
+            fenceWaitMs += std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    // OS sleeps wake late by up to a scheduler tick: sleep short of the
+    // deadline by the worst recent oversleep, spin the rest
+    // ------------------------------------------------------------------------
+    void sleepUntil(Clock::time_point deadline)
+    {
+        double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+        if (remaining > sleepErrorSeconds)
+        {
+            double requested = remaining - sleepErrorSeconds;
+            Clock::time_point before = Clock::now();
+            std::this_thread::sleep_for(std::chrono::duration<double>(requested));
+            double overslept = std::chrono::duration<double>(Clock::now() - before).count() - requested;
+            // jump up on a late wake-up, decay slowly once sleeps are on time
+            sleepErrorSeconds = std::max(overslept, sleepErrorSeconds * 0.95);
+        }
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+    }
+};
+#endif
@@ -0,0 +1,52 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+// Frame times of a run, summarized as average and percentiles so runs on
+// different hosts can be compared line by line.
+// ------------------------------------------------------------------------
+class FrameStats
+{
+public:
+    void add(double milliseconds)
+    {
+        times.push_back(milliseconds);
+    }
+    // ------------------------------------------------------------------------
+    size_t getCount() const { return times.size(); }
+    double average() const
+    {
+        double total = 0.0;
+        for (double time : times)
+            total += time;
+        return times.empty() ? 0.0 : total / times.size();
+    }
+    // nearest-rank percentile, 0..100
+    // ------------------------------------------------------------------------
+    double percentile(double p) const
+    {
+        if (times.empty())
+            return 0.0;
+        std::vector<double> sorted(times);
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+    // one line: name, frame count, average, fps and percentiles in ms
+    // ------------------------------------------------------------------------
+    void print(const std::string& name) const
+    {
+        double mean = average();
+        std::cout << name << ": " << times.size() << " frames, " << mean << " ms avg (" << (mean > 0.0 ? 1000.0 / mean : 0.0)
+            << " fps), min " << percentile(0.0) << ", p50 " << percentile(50.0) << ", p95 " << percentile(95.0)
+            << ", p99 " << percentile(99.0) << ", max " << percentile(100.0) << " ms" << std::endl;
+    }
+
+private:
+    std::vector<double> times;
+};
+#endif
@@ -0,0 +1,345 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <GL/glew.h>
+
+// Shadows the GL state the renderer touches and drops calls that would not
+// change anything before they reach the driver. Everything that binds or
+// toggles state should go through here; call invalidate() after code that
+// talks to GL directly so the shadow copy is not trusted any more.
+class GLStateCache
+{
+public:
+    struct Counters
+    {
+        unsigned long long issued = 0;
+        unsigned long long filtered = 0;
+    };
+
+    static GLStateCache& instance()
+    {
+        static GLStateCache cache;
+        return cache;
+    }
+    // forget everything; the next call of each kind always reaches GL
+    // ------------------------------------------------------------------------
+    void invalidate()
+    {
+        program = vertexArray = UNKNOWN;
+        for (int i = 0; i < BUFFER_TARGETS; ++i)
+            buffers[i] = UNKNOWN;
+        for (int t = 0; t < INDEXED_TARGETS; ++t)
+            for (int i = 0; i < MAX_INDEXED; ++i)
+                indexed[t][i] = IndexedBinding();
+        activeUnit = UNKNOWN;
+        for (unsigned int u = 0; u < MAX_TEXTURE_UNITS; ++u)
+            for (int t = 0; t < TEXTURE_TARGETS; ++t)
+                textures[u][t] = UNKNOWN;
+        for (int i = 0; i < CAPABILITIES; ++i)
+            capabilities[i] = -1;
+        blendSrc = blendDst = UNKNOWN;
+        depthFunction = UNKNOWN;
+        depthWrite = -1;
+        cullMode = UNKNOWN;
+        polygonFill = UNKNOWN;
+        clearColorValid = false;
+    }
+    // ------------------------------------------------------------------------
+    void useProgram(GLuint id)
+    {
+        if (filter(program == id))
+            return;
+        program = id;
+        glUseProgram(id);
+    }
+    // ------------------------------------------------------------------------
+    void bindVertexArray(GLuint id)
+    {
+        if (filter(vertexArray == id))
+            return;
+        vertexArray = id;
+        glBindVertexArray(id);
+        // the element buffer binding belongs to the VAO
+        buffers[bufferIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+    // ------------------------------------------------------------------------
+    void bindBuffer(GLenum target, GLuint id)
+    {
+        int index = bufferIndex(target);
+        if (index < 0)
+        {
+            count(false);
+            glBindBuffer(target, id);
+            return;
+        }
+        if (filter(buffers[index] == id))
+            return;
+        buffers[index] = id;
+        glBindBuffer(target, id);
+    }
+    // ------------------------------------------------------------------------
+    void bindBufferRange(GLenum target, GLuint binding, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        IndexedBinding* slot = indexedSlot(target, binding);
+        if (slot && filter(slot->buffer == id && slot->offset == offset && slot->size == size))
+            return;
+        if (!slot)
+            count(false);
+        glBindBufferRange(target, binding, id, offset, size);
+        setIndexed(target, slot, id, offset, size);
+    }
+    // ------------------------------------------------------------------------
+    void bindBufferBase(GLenum target, GLuint binding, GLuint id)
+    {
+        IndexedBinding* slot = indexedSlot(target, binding);
+        if (slot && filter(slot->buffer == id && slot->offset == 0 && slot->size == WHOLE_BUFFER))
+            return;
+        if (!slot)
+            count(false);
+        glBindBufferBase(target, binding, id);
+        setIndexed(target, slot, id, 0, WHOLE_BUFFER);
+    }
+    // ------------------------------------------------------------------------
+    void bindTexture(GLuint unit, GLenum target, GLuint id)
+    {
+        int index = textureIndex(target);
+        if (unit >= MAX_TEXTURE_UNITS || index < 0)
+        {
+            activeTexture(unit);
+            count(false);
+            glBindTexture(target, id);
+            return;
+        }
+        if (filter(textures[unit][index] == id))
+            return;
+        activeTexture(unit);
+        textures[unit][index] = id;
+        glBindTexture(target, id);
+    }
+    // ------------------------------------------------------------------------
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        int index = capabilityIndex(capability);
+        if (index >= 0 && filter(capabilities[index] == (enabled ? 1 : 0)))
+            return;
+        if (index >= 0)
+            capabilities[index] = enabled ? 1 : 0;
+        else
+            count(false);
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+    // ------------------------------------------------------------------------
+    void blendFunc(GLenum src, GLenum dst)
+    {
+        if (filter(blendSrc == src && blendDst == dst))
+            return;
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+    // ------------------------------------------------------------------------
+    void depthFunc(GLenum function)
+    {
+        if (filter(depthFunction == function))
+            return;
+        depthFunction = function;
+        glDepthFunc(function);
+    }
+    // ------------------------------------------------------------------------
+    void depthMask(bool write)
+    {
+        if (filter(depthWrite == (write ? 1 : 0)))
+            return;
+        depthWrite = write ? 1 : 0;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+    // ------------------------------------------------------------------------
+    void cullFace(GLenum mode)
+    {
+        if (filter(cullMode == mode))
+            return;
+        cullMode = mode;
+        glCullFace(mode);
+    }
+    // core profile only accepts GL_FRONT_AND_BACK, so only the mode is tracked
+    // ------------------------------------------------------------------------
+    void polygonMode(GLenum mode)
+    {
+        if (filter(polygonFill == mode))
+            return;
+        polygonFill = mode;
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+    // ------------------------------------------------------------------------
+    void clearColor(float r, float g, float b, float a)
+    {
+        if (filter(clearColorValid && clear[0] == r && clear[1] == g && clear[2] == b && clear[3] == a))
+            return;
+        clear[0] = r; clear[1] = g; clear[2] = b; clear[3] = a;
+        clearColorValid = true;
+        glClearColor(r, g, b, a);
+    }
+    // an object is being deleted; GL may hand its name out again
+    // ------------------------------------------------------------------------
+    void forgetProgram(GLuint id)
+    {
+        if (program == id)
+            program = UNKNOWN;
+    }
+    // ------------------------------------------------------------------------
+    void forgetVertexArray(GLuint id)
+    {
+        if (vertexArray == id)
+            vertexArray = UNKNOWN;
+    }
+    // ------------------------------------------------------------------------
+    void forgetBuffer(GLuint id)
+    {
+        for (int i = 0; i < BUFFER_TARGETS; ++i)
+            if (buffers[i] == id)
+                buffers[i] = UNKNOWN;
+        for (int t = 0; t < INDEXED_TARGETS; ++t)
+            for (int i = 0; i < MAX_INDEXED; ++i)
+                if (indexed[t][i].buffer == id)
+                    indexed[t][i] = IndexedBinding();
+    }
+    // ------------------------------------------------------------------------
+    GLuint currentProgram() const { return program; }
+    GLuint currentVertexArray() const { return vertexArray; }
+    const Counters& counters() const { return stats; }
+    void resetCounters() { stats = Counters(); }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const GLsizeiptr WHOLE_BUFFER = -1;
+    static const int BUFFER_TARGETS = 8;
+    static const int INDEXED_TARGETS = 2;
+    static const int MAX_INDEXED = 16;
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+    static const int TEXTURE_TARGETS = 4;
+    static const int CAPABILITIES = 8;
+
+    struct IndexedBinding
+    {
+        GLuint buffer = UNKNOWN;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    GLuint program, vertexArray;
+    GLuint buffers[BUFFER_TARGETS];
+    IndexedBinding indexed[INDEXED_TARGETS][MAX_INDEXED];
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    int capabilities[CAPABILITIES];
+    GLenum blendSrc, blendDst;
+    GLenum depthFunction;
+    int depthWrite;
+    GLenum cullMode;
+    GLenum polygonFill;
+    float clear[4];
+    bool clearColorValid;
+    Counters stats;
+
+    GLStateCache() { invalidate(); }
+
+    // count the call and report whether it can be skipped
+    // ------------------------------------------------------------------------
+    bool filter(bool redundant)
+    {
+        count(redundant);
+        return redundant;
+    }
+    // ------------------------------------------------------------------------
+    void count(bool filteredCall)
+    {
+        if (filteredCall)
+            stats.filtered++;
+        else
+            stats.issued++;
+    }
+    // selecting the unit is part of a bind, not a call of its own: count it
+    // only when it reaches GL
+    // ------------------------------------------------------------------------
+    void activeTexture(GLuint unit)
+    {
+        if (activeUnit == unit)
+            return;
+        count(false);
+        activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    // glBindBufferBase/Range also change the generic binding of the target
+    // ------------------------------------------------------------------------
+    void setIndexed(GLenum target, IndexedBinding* slot, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        if (slot)
+        {
+            slot->buffer = id;
+            slot->offset = offset;
+            slot->size = size;
+        }
+        int index = bufferIndex(target);
+        if (index >= 0)
+            buffers[index] = id;
+    }
+    // ------------------------------------------------------------------------
+    IndexedBinding* indexedSlot(GLenum target, GLuint binding)
+    {
+        if (binding >= (GLuint)MAX_INDEXED)
+            return nullptr;
+        if (target == GL_UNIFORM_BUFFER)
+            return &indexed[0][binding];
+        if (target == GL_SHADER_STORAGE_BUFFER)
+            return &indexed[1][binding];
+        return nullptr;
+    }
+    // ------------------------------------------------------------------------
+    static int bufferIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_SHADER_STORAGE_BUFFER: return 3;
+        case GL_DRAW_INDIRECT_BUFFER: return 4;
+        case GL_COPY_READ_BUFFER: return 5;
+        case GL_COPY_WRITE_BUFFER: return 6;
+        case GL_DISPATCH_INDIRECT_BUFFER: return 7;
+        default: return -1;
+        }
+    }
+    // ------------------------------------------------------------------------
+    static int textureIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        case GL_TEXTURE_3D: return 3;
+        default: return -1;
+        }
+    }
+    // ------------------------------------------------------------------------
+    static int capabilityIndex(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_BLEND: return 0;
+        case GL_DEPTH_TEST: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_SCISSOR_TEST: return 3;
+        case GL_STENCIL_TEST: return 4;
+        case GL_POLYGON_OFFSET_FILL: return 5;
+        case GL_MULTISAMPLE: return 6;
+        case GL_FRAMEBUFFER_SRGB: return 7;
+        default: return -1;
+        }
+    }
+};
+#endif
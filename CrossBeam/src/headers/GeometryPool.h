@@ -0,0 +1,356 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "VertexLayout.h"
+#include "VertexPacking.h"
+#include "RangeAllocator.h"
+#include "GLStateCache.h"
+
+// ------------------------------------------------------------------------
+struct GeometryHandle
+{
+    int slot = -1;
+    bool valid() const { return slot >= 0; }
+};
+
+// Where a mesh lives inside the pool. Indices are local to the mesh, draws
+// add baseVertex; firstIndex counts indices, not bytes.
+// ------------------------------------------------------------------------
+struct GeometryRange
+{
+    unsigned int arena = 0;
+    GLenum primitive = GL_TRIANGLES;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    QuantizationBounds quantization;
+};
+
+// All static meshes in a few large buffers: one arena (VBO + EBO + VAO) per
+// vertex format, sub-allocated with RangeAllocator. Meshes of one format
+// share a VAO and differ only in baseVertex/firstIndex, which is what lets
+// them be merged into multi-draw calls later.
+//
+// Arenas grow by doubling when full and are compacted when fragmentation is
+// what made an allocation fail. Both move meshes, so GeometryRanges must be
+// looked up again whenever getGeneration() changes.
+// ------------------------------------------------------------------------
+class GeometryPool
+{
+public:
+    struct Stats
+    {
+        unsigned int arenas = 0;
+        unsigned int meshes = 0;
+        unsigned long long vertexBytes = 0, vertexCapacityBytes = 0;
+        unsigned long long indexBytes = 0, indexCapacityBytes = 0;
+        unsigned long long moves = 0;
+    };
+
+    // capacities are per arena, in vertices and indices; 16-bit pools only
+    // take meshes of up to 65536 vertices
+    GeometryPool(uint32_t vertexCapacity = 64 * 1024, uint32_t indexCapacity = 256 * 1024, GLenum indexType = GL_UNSIGNED_INT)
+        : initialVertices(vertexCapacity), initialIndices(indexCapacity), indexType(indexType)
+    {
+    }
+    // ------------------------------------------------------------------------
+    ~GeometryPool()
+    {
+        for (Arena& arena : arenas)
+            destroyBuffers(arena.VAO, arena.VBO, arena.EBO);
+    }
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // copy a mesh in; an empty index list draws the vertices in order
+    // ------------------------------------------------------------------------
+    GeometryHandle add(const VertexLayout& layout, const void* vertices, uint32_t vertexCount,
+        const std::vector<uint32_t>& indices = std::vector<uint32_t>(), GLenum primitive = GL_TRIANGLES,
+        const QuantizationBounds& quantization = QuantizationBounds())
+    {
+        GeometryHandle handle;
+        if (vertexCount == 0)
+            return handle;
+        if (indexType == GL_UNSIGNED_SHORT && vertexCount > 65536)
+        {
+            std::cout << "ERROR::GEOMETRY_POOL::TOO_MANY_VERTICES_FOR_16_BIT_INDICES: " << vertexCount << std::endl;
+            return handle;
+        }
+        std::vector<uint32_t> sequential;
+        const std::vector<uint32_t>* meshIndices = &indices;
+        if (indices.empty())
+        {
+            sequential.resize(vertexCount);
+            for (uint32_t i = 0; i < vertexCount; ++i)
+                sequential[i] = i;
+            meshIndices = &sequential;
+        }
+        uint32_t indexCount = (uint32_t)meshIndices->size();
+
+        unsigned int arenaIndex = findArena(layout);
+        uint32_t vertexOffset, indexOffset;
+        allocate(arenaIndex, vertexCount, indexCount, vertexOffset, indexOffset);
+        Arena& arena = arenas[arenaIndex];
+
+        GLStateCache& state = GLStateCache::instance();
+        // the copy targets leave the VAO's element buffer binding alone
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, arena.VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)vertexOffset * layout.getStride(), (GLsizeiptr)vertexCount * layout.getStride(), vertices);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, arena.EBO);
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            std::vector<uint16_t> shortIndices(meshIndices->begin(), meshIndices->end());
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)indexOffset * 2, (GLsizeiptr)indexCount * 2, shortIndices.data());
+        }
+        else
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)indexOffset * 4, (GLsizeiptr)indexCount * 4, meshIndices->data());
+
+        GeometryRange range;
+        range.arena = arenaIndex;
+        range.primitive = primitive;
+        range.firstIndex = indexOffset;
+        range.indexCount = indexCount;
+        range.baseVertex = (int32_t)vertexOffset;
+        range.vertexCount = vertexCount;
+        range.quantization = quantization;
+
+        if (!freeSlots.empty())
+        {
+            handle.slot = freeSlots.back();
+            freeSlots.pop_back();
+            entries[handle.slot] = range;
+        }
+        else
+        {
+            handle.slot = (int)entries.size();
+            entries.push_back(range);
+        }
+        live.resize(entries.size(), 0);
+        live[handle.slot] = 1;
+        meshCount++;
+        return handle;
+    }
+    // ------------------------------------------------------------------------
+    void remove(GeometryHandle handle)
+    {
+        if (!isLive(handle))
+            return;
+        const GeometryRange& range = entries[handle.slot];
+        arenas[range.arena].vertices.free((uint32_t)range.baseVertex);
+        arenas[range.arena].indices.free(range.firstIndex);
+        live[handle.slot] = 0;
+        freeSlots.push_back(handle.slot);
+        meshCount--;
+    }
+    // ------------------------------------------------------------------------
+    const GeometryRange& get(GeometryHandle handle) const
+    {
+        return entries[handle.slot];
+    }
+    // ------------------------------------------------------------------------
+    void bind(unsigned int arena) const
+    {
+        GLStateCache::instance().bindVertexArray(arenas[arena].VAO);
+    }
+    // one draw; batches of meshes should go through a multi-draw instead
+    // ------------------------------------------------------------------------
+    void draw(GeometryHandle handle) const
+    {
+        const GeometryRange& range = entries[handle.slot];
+        bind(range.arena);
+        glDrawElementsBaseVertex(range.primitive, range.indexCount, indexType,
+            (void*)((size_t)range.firstIndex * indexSize()), range.baseVertex);
+    }
+    // pack every arena's meshes to the front of its buffers
+    // ------------------------------------------------------------------------
+    void defragment()
+    {
+        for (unsigned int a = 0; a < arenas.size(); ++a)
+            rebuild(a, arenas[a].vertices.getCapacity(), arenas[a].indices.getCapacity());
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getArenaCount() const { return (unsigned int)arenas.size(); }
+    unsigned int getVertexArray(unsigned int arena) const { return arenas[arena].VAO; }
+    unsigned int getVertexBuffer(unsigned int arena) const { return arenas[arena].VBO; }
+    unsigned int getIndexBuffer(unsigned int arena) const { return arenas[arena].EBO; }
+    const VertexLayout& getLayout(unsigned int arena) const { return arenas[arena].layout; }
+    GLenum getIndexType() const { return indexType; }
+    unsigned int indexSize() const { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+    // bumped whenever meshes move
+    unsigned long long getGeneration() const { return generation; }
+    // ------------------------------------------------------------------------
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.arenas = (unsigned int)arenas.size();
+        stats.meshes = meshCount;
+        stats.moves = moves;
+        for (const Arena& arena : arenas)
+        {
+            unsigned int stride = arena.layout.getStride();
+            stats.vertexBytes += (unsigned long long)arena.vertices.getUsed() * stride;
+            stats.vertexCapacityBytes += (unsigned long long)arena.vertices.getCapacity() * stride;
+            stats.indexBytes += (unsigned long long)arena.indices.getUsed() * indexSize();
+            stats.indexCapacityBytes += (unsigned long long)arena.indices.getCapacity() * indexSize();
+        }
+        return stats;
+    }
+
+private:
+    struct Arena
+    {
+        VertexLayout layout;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        RangeAllocator vertices;
+        RangeAllocator indices;
+    };
+
+    uint32_t initialVertices, initialIndices;
+    GLenum indexType;
+    std::vector<Arena> arenas;
+    std::vector<GeometryRange> entries;
+    std::vector<char> live;
+    std::vector<int> freeSlots;
+    unsigned int meshCount = 0;
+    unsigned long long generation = 0;
+    unsigned long long moves = 0;
+
+    bool isLive(GeometryHandle handle) const
+    {
+        return handle.valid() && handle.slot < (int)live.size() && live[handle.slot];
+    }
+    // ------------------------------------------------------------------------
+    unsigned int findArena(const VertexLayout& layout)
+    {
+        for (unsigned int a = 0; a < arenas.size(); ++a)
+            if (arenas[a].layout == layout)
+                return a;
+        Arena arena;
+        arena.layout = layout;
+        arenas.push_back(arena);
+        unsigned int index = (unsigned int)arenas.size() - 1;
+        rebuild(index, initialVertices, initialIndices);
+        return index;
+    }
+    // both ranges of a new mesh; compacts the arena when the space is there
+    // but fragmented and doubles whichever buffer is short otherwise
+    // ------------------------------------------------------------------------
+    void allocate(unsigned int a, uint32_t vertexCount, uint32_t indexCount, uint32_t& vertexOffset, uint32_t& indexOffset)
+    {
+        if (tryAllocate(arenas[a], vertexCount, indexCount, vertexOffset, indexOffset))
+            return;
+        uint32_t vertexCapacity = arenas[a].vertices.getCapacity();
+        uint32_t indexCapacity = arenas[a].indices.getCapacity();
+        while (vertexCapacity - arenas[a].vertices.getUsed() < vertexCount)
+            vertexCapacity *= 2;
+        while (indexCapacity - arenas[a].indices.getUsed() < indexCount)
+            indexCapacity *= 2;
+        // after compaction all free space is one range at the end, so this fits
+        rebuild(a, vertexCapacity, indexCapacity);
+        tryAllocate(arenas[a], vertexCount, indexCount, vertexOffset, indexOffset);
+    }
+    // ------------------------------------------------------------------------
+    static bool tryAllocate(Arena& arena, uint32_t vertexCount, uint32_t indexCount, uint32_t& vertexOffset, uint32_t& indexOffset)
+    {
+        vertexOffset = arena.vertices.allocate(vertexCount);
+        indexOffset = arena.indices.allocate(indexCount);
+        if (vertexOffset != RangeAllocator::INVALID && indexOffset != RangeAllocator::INVALID)
+            return true;
+        if (vertexOffset != RangeAllocator::INVALID)
+            arena.vertices.free(vertexOffset);
+        if (indexOffset != RangeAllocator::INVALID)
+            arena.indices.free(indexOffset);
+        return false;
+    }
+    // new buffers of the given capacities with every live mesh of the arena
+    // copied in back to back; the VAO is re-pointed at them
+    // ------------------------------------------------------------------------
+    void rebuild(unsigned int a, uint32_t vertexCapacity, uint32_t indexCapacity)
+    {
+        Arena& arena = arenas[a];
+        GLStateCache& state = GLStateCache::instance();
+        unsigned int stride = arena.layout.getStride();
+
+        unsigned int VBO = 0, EBO = 0;
+        glGenBuffers(1, &VBO);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+        glGenBuffers(1, &EBO);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * indexSize(), NULL, GL_STATIC_DRAW);
+
+        RangeAllocator vertices(vertexCapacity), indices(indexCapacity);
+        bool moved = false;
+        for (size_t slot = 0; slot < entries.size(); ++slot)
+        {
+            GeometryRange& range = entries[slot];
+            if (!live[slot] || range.arena != a)
+                continue;
+            uint32_t vertexOffset = vertices.allocate(range.vertexCount);
+            uint32_t indexOffset = indices.allocate(range.indexCount);
+            copy(arena.VBO, VBO, (GLintptr)range.baseVertex * stride, (GLintptr)vertexOffset * stride, (GLsizeiptr)range.vertexCount * stride);
+            copy(arena.EBO, EBO, (GLintptr)range.firstIndex * indexSize(), (GLintptr)indexOffset * indexSize(), (GLsizeiptr)range.indexCount * indexSize());
+            if (range.baseVertex != (int32_t)vertexOffset || range.firstIndex != indexOffset)
+            {
+                moved = true;
+                moves++;
+            }
+            range.baseVertex = (int32_t)vertexOffset;
+            range.firstIndex = indexOffset;
+        }
+        if (moved)
+            generation++;
+
+        unsigned int VAO = 0;
+        glGenVertexArrays(1, &VAO);
+        state.bindVertexArray(VAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        arena.layout.apply();
+        // recorded in the VAO
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        state.bindVertexArray(0);
+
+        destroyBuffers(arena.VAO, arena.VBO, arena.EBO);
+        arena.VAO = VAO;
+        arena.VBO = VBO;
+        arena.EBO = EBO;
+        arena.vertices = vertices;
+        arena.indices = indices;
+    }
+    // ------------------------------------------------------------------------
+    static void copy(unsigned int from, unsigned int to, GLintptr fromOffset, GLintptr toOffset, GLsizeiptr size)
+    {
+        if (size == 0)
+            return;
+        GLStateCache& state = GLStateCache::instance();
+        state.bindBuffer(GL_COPY_READ_BUFFER, from);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, to);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, fromOffset, toOffset, size);
+    }
+    // ------------------------------------------------------------------------
+    static void destroyBuffers(unsigned int VAO, unsigned int VBO, unsigned int EBO)
+    {
+        GLStateCache& state = GLStateCache::instance();
+        if (VAO)
+        {
+            state.forgetVertexArray(VAO);
+            glDeleteVertexArrays(1, &VAO);
+        }
+        unsigned int buffers[2] = { VBO, EBO };
+        for (unsigned int buffer : buffers)
+            if (buffer)
+            {
+                state.forgetBuffer(buffer);
+                glDeleteBuffers(1, &buffer);
+            }
+    }
+};
+#endif
@@ -0,0 +1,451 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <GL/glew.h>
+
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <cstdint>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
+
+#include "Math.h"
+#include "BasicShader.h"
+#include "GeometryPool.h"
+#include "MultiDraw.h"
+#include "HiZPyramid.h"
+#include "UniformBuffer.h"
+#include "GLStateCache.h"
+
+// std140 mirror of CullViewBlock in res/shaders/CullingCompute.shader
+// ------------------------------------------------------------------------
+struct CullViewBlock
+{
+    Mat4 viewProjection;
+    // left, right, bottom, top, near, far; normalized, pointing inwards
+    Vec4 planes[6];
+    // x, y = Hi-Z size, z = Hi-Z levels (0 = frustum only), w = object count
+    uint32_t params[4] = { 0, 0, 0, 0 };
+
+    // planes extracted from the matrix (Gribb/Hartmann), GL clip space
+    static CullViewBlock fromMatrix(const Mat4& viewProjection)
+    {
+        CullViewBlock view;
+        view.viewProjection = viewProjection;
+        const float* m = viewProjection.m;
+        for (int i = 0; i < 6; ++i)
+        {
+            int row = i / 2;
+            float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+            Vec4 plane(m[3] + sign * m[row], m[7] + sign * m[4 + row], m[11] + sign * m[8 + row], m[15] + sign * m[12 + row]);
+            float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            view.planes[i] = Vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+        }
+        return view;
+    }
+};
+static_assert(sizeof(CullViewBlock) == 64 + 6 * 16 + 16, "CullViewBlock must match std140");
+
+// std430 mirror of CullObject: the bounds plus the command drawn if visible
+// ------------------------------------------------------------------------
+struct CullObject
+{
+    // world-space centre, w = radius
+    Vec4 sphere;
+    DrawElementsIndirectCommand command;
+    // counter and first output slot of the object's group
+    uint32_t group;
+    uint32_t outputBase;
+    uint32_t padding;
+};
+static_assert(sizeof(CullObject) == 48, "CullObject must match std430");
+
+// Occlusion half of CullSphere(). closest is lowered to the distance of every
+// value compared on the way (texel edges, depths, w) from flipping its test.
+// ------------------------------------------------------------------------
+inline bool CullOccluded(const Vec4& sphere, const CullViewBlock& view, const DepthPyramid& hiZ, float& closest)
+{
+    // screen rectangle and nearest depth of the sphere's bounding box
+    float bounds[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; ++i)
+    {
+        Vec4 corner(sphere.x + ((i & 1) != 0 ? sphere.w : -sphere.w),
+            sphere.y + ((i & 2) != 0 ? sphere.w : -sphere.w),
+            sphere.z + ((i & 4) != 0 ? sphere.w : -sphere.w), 1.0f);
+        Vec4 clip = view.viewProjection * corner;
+        closest = std::min(closest, std::fabs(clip.w));
+        // reaches behind the camera, the projection is meaningless
+        if (clip.w <= 0.0f)
+            return false;
+        float u = clip.x / clip.w * 0.5f + 0.5f, v = clip.y / clip.w * 0.5f + 0.5f;
+        bounds[0] = std::min(bounds[0], u);
+        bounds[1] = std::min(bounds[1], v);
+        bounds[2] = std::max(bounds[2], u);
+        bounds[3] = std::max(bounds[3], v);
+        nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+    }
+    int size[2] = { (int)hiZ.width, (int)hiZ.height };
+    int texels[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        float scaled = std::min(std::max(bounds[i], 0.0f), 1.0f) * (float)size[i & 1];
+        if (bounds[i] > 0.0f && bounds[i] < 1.0f)
+            closest = std::min(closest, std::fabs(scaled - std::round(scaled)));
+        texels[i] = std::min(std::max((int)std::floor(scaled), 0), size[i & 1] - 1);
+    }
+    // finest level at which the rectangle spans at most 2x2 texels
+    int levels = (int)hiZ.getLevelCount();
+    int level = 0, first[2], last[2];
+    for (;; ++level)
+    {
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            int levelSize = (int)HiZLevelSize((unsigned int)size[axis], (unsigned int)level);
+            first[axis] = std::min(texels[axis] >> level, levelSize - 1);
+            last[axis] = std::min(texels[axis + 2] >> level, levelSize - 1);
+        }
+        if ((last[0] - first[0] <= 1 && last[1] - first[1] <= 1) || level == levels - 1)
+            break;
+    }
+    float farthest = 0.0f;
+    for (int y = first[1]; y <= last[1]; ++y)
+        for (int x = first[0]; x <= last[0]; ++x)
+            farthest = std::max(farthest, hiZ.fetch((unsigned int)level, (unsigned int)x, (unsigned int)y));
+    closest = std::min(closest, std::fabs(nearest - farthest));
+    return nearest > farthest;
+}
+// CPU reference of the compute pass, step for step: true when the sphere
+// survives the frustum and (with a pyramid) the Hi-Z test. margin receives
+// how close the decision came to going the other way; the GPU may round
+// differently below that.
+// ------------------------------------------------------------------------
+inline bool CullSphere(const Vec4& sphere, const CullViewBlock& view, const DepthPyramid* hiZ, float* margin = nullptr)
+{
+    float closest = FLT_MAX;
+    bool visible = true;
+    for (int i = 0; i < 6 && visible; ++i)
+    {
+        const Vec4& plane = view.planes[i];
+        float distance = plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w;
+        closest = std::min(closest, std::fabs(distance + sphere.w));
+        visible = !(distance < -sphere.w);
+    }
+    if (visible && hiZ)
+        visible = !CullOccluded(sphere, view, *hiZ, closest);
+    if (margin)
+        *margin = closest;
+    return visible;
+}
+
+// GPU-driven culling of a static object set drawn from a GeometryPool.
+// Object bounds, draw commands and records live in SSBOs; cull() runs one
+// compute dispatch that tests every object against the frustum and,
+// optionally, a HiZPyramid and appends the survivors of each group (arena
+// and primitive mode, see MultiDrawGroupKey()) to that group's output range
+// through an atomic counter. draw() then issues one multi-draw per group
+// that reads the count from the counter buffer
+// (ARB_indirect_parameters), so the CPU never sees the visible set.
+// Without indirect parameters the command range is cleared before culling
+// and drawn whole; the zeroed commands after the survivors draw nothing.
+//
+//     culling.add(mesh, worldSphere, object);  // once; update() when it moves
+//     culling.cull(viewProjection, &hiZ);
+//     multiDrawShader.use();
+//     culling.draw();
+//
+// Needs compute shaders (GL 4.3) on top of MultiDrawBatch's requirements;
+// draws use the MULTI_DRAW shader variant.
+// ------------------------------------------------------------------------
+class GpuCulling
+{
+public:
+    struct Stats
+    {
+        unsigned int objects = 0;
+        unsigned int groups = 0;
+        unsigned int uploads = 0;
+        unsigned int calls = 0;
+    };
+
+    GpuCulling(GeometryPool& pool)
+        : pool(pool), viewUniforms(UNIFORM_BINDING_CULL_VIEW, 4 * 1024),
+        program(Shader::compute("res/shaders/CullingCompute.shader"))
+    {
+        int offsetAlignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        // smallest record count whose byte size is a multiple of the alignment
+        recordStep = (uint32_t)offsetAlignment / std::gcd((uint32_t)offsetAlignment, (uint32_t)sizeof(ObjectBlock));
+        countDraws = GLEW_ARB_indirect_parameters != 0;
+        glGenBuffers(BUFFER_COUNT, buffers);
+    }
+    // ------------------------------------------------------------------------
+    ~GpuCulling()
+    {
+        GLStateCache& state = GLStateCache::instance();
+        for (int i = 0; i < BUFFER_COUNT; ++i)
+            state.forgetBuffer(buffers[i]);
+        glDeleteBuffers(BUFFER_COUNT, buffers);
+        state.forgetProgram(program.ID);
+        glDeleteProgram(program.ID);
+    }
+    GpuCulling(const GpuCulling&) = delete;
+    GpuCulling& operator=(const GpuCulling&) = delete;
+
+    // ------------------------------------------------------------------------
+    static bool isSupported()
+    {
+        bool compute = GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_image_load_store);
+        return compute && MultiDrawBatch::isSupported();
+    }
+    // add an object and return its index; sphere is its world-space bounds
+    // ------------------------------------------------------------------------
+    unsigned int add(GeometryHandle mesh, const Vec4& sphere, const ObjectBlock& object)
+    {
+        Entry entry;
+        entry.mesh = mesh;
+        entry.sphere = sphere;
+        entry.object = object;
+        entries.push_back(entry);
+        dirty = true;
+        return (unsigned int)entries.size() - 1;
+    }
+    // move or recolor an object; written straight into the SSBOs when they are current
+    // ------------------------------------------------------------------------
+    void update(unsigned int index, const Vec4& sphere, const ObjectBlock& object)
+    {
+        Entry& entry = entries[index];
+        entry.sphere = sphere;
+        entry.object = object;
+        // moved meshes take a full upload, which picks this change up too
+        if (dirty || generation != pool.getGeneration())
+            return;
+        GLStateCache& state = GLStateCache::instance();
+        CullObject cullObject = makeCullObject(index);
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[OBJECTS]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)index * sizeof(CullObject), sizeof(CullObject), &cullObject);
+        ObjectBlock record = makeRecord(index);
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[RECORDS]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)index * sizeof(ObjectBlock), sizeof(ObjectBlock), &record);
+    }
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        entries.clear();
+        groups.clear();
+        dirty = true;
+    }
+    // test every object and compact the survivors; nothing comes back to the CPU
+    // ------------------------------------------------------------------------
+    void cull(const Mat4& viewProjection, const HiZPyramid* hiZ = nullptr)
+    {
+        if (entries.empty())
+            return;
+        if (dirty || generation != pool.getGeneration())
+            upload();
+        stats.calls = 0;
+        GLStateCache& state = GLStateCache::instance();
+
+        CullViewBlock view = CullViewBlock::fromMatrix(viewProjection);
+        if (hiZ)
+        {
+            view.params[0] = hiZ->getWidth();
+            view.params[1] = hiZ->getHeight();
+            view.params[2] = hiZ->getLevelCount();
+            state.bindTexture(0, GL_TEXTURE_2D, hiZ->getTexture());
+        }
+        view.params[3] = (uint32_t)entries.size();
+        viewUniforms.beginFrame();
+        viewUniforms.pushAndBind(view);
+
+        // a NULL clear value zeroes the buffer
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[COUNTERS]);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        if (!countDraws)
+        {
+            state.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[COMMANDS]);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        }
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_CULL_OBJECTS, buffers[OBJECTS]);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_CULL_RECORDS, buffers[RECORDS]);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_CULL_COMMANDS, buffers[COMMANDS]);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_CULL_VISIBLE_RECORDS, buffers[VISIBLE_RECORDS]);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_CULL_COUNTERS, buffers[COUNTERS]);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_CULL_VISIBILITY, buffers[VISIBILITY]);
+
+        program.use();
+        glDispatchCompute(((GLuint)entries.size() + 63) / 64, 1, 1);
+        // consumed as draw commands and parameters, by the vertex shader, and by readbacks
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        viewUniforms.endFrame();
+    }
+    // one multi-draw per group over the survivors of the last cull()
+    // ------------------------------------------------------------------------
+    void draw()
+    {
+        GLStateCache& state = GLStateCache::instance();
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[COMMANDS]);
+        if (countDraws)
+            state.bindBuffer(GL_PARAMETER_BUFFER_ARB, buffers[COUNTERS]);
+        for (size_t g = 0; g < groups.size(); ++g)
+        {
+            const Group& group = groups[g];
+            pool.bind(group.arena);
+            state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DRAWS, buffers[VISIBLE_RECORDS],
+                (GLintptr)group.outputBase * sizeof(ObjectBlock), (GLsizeiptr)group.count * sizeof(ObjectBlock));
+            const void* indirect = (const void*)((size_t)group.outputBase * sizeof(DrawElementsIndirectCommand));
+            if (countDraws)
+                glMultiDrawElementsIndirectCountARB(group.primitive, pool.getIndexType(), indirect,
+                    (GLintptr)(g * sizeof(uint32_t)), (GLsizei)group.count, 0);
+            else
+                glMultiDrawElementsIndirect(group.primitive, pool.getIndexType(), indirect, (GLsizei)group.count, 0);
+            stats.calls++;
+        }
+    }
+    // one flag per object in add() order, 1 = visible. Waits for the GPU,
+    // for tests and debugging only.
+    // ------------------------------------------------------------------------
+    std::vector<uint32_t> readVisibility()
+    {
+        std::vector<uint32_t> visibility(entries.size(), 0);
+        if (entries.empty() || dirty)
+            return visibility;
+        GLStateCache::instance().bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[VISIBILITY]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)visibility.size() * sizeof(uint32_t), visibility.data());
+        return visibility;
+    }
+    // survivors of the last cull() over all groups; waits for the GPU
+    // ------------------------------------------------------------------------
+    unsigned int readVisibleCount()
+    {
+        std::vector<uint32_t> counters(groups.size(), 0);
+        if (groups.empty() || dirty)
+            return 0;
+        GLStateCache::instance().bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[COUNTERS]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)counters.size() * sizeof(uint32_t), counters.data());
+        return std::accumulate(counters.begin(), counters.end(), 0u);
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getObjectCount() const { return (unsigned int)entries.size(); }
+    const Vec4& getSphere(unsigned int index) const { return entries[index].sphere; }
+    bool hasDrawCount() const { return countDraws; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    enum Buffer
+    {
+        OBJECTS, RECORDS, COMMANDS, VISIBLE_RECORDS, COUNTERS, VISIBILITY, BUFFER_COUNT
+    };
+    struct Entry
+    {
+        GeometryHandle mesh;
+        Vec4 sphere;
+        ObjectBlock object;
+    };
+    // the objects of one arena and primitive mode: counter index = group index
+    struct Group
+    {
+        unsigned int arena = 0;
+        GLenum primitive = GL_TRIANGLES;
+        uint32_t outputBase = 0;
+        uint32_t count = 0;
+    };
+
+    GeometryPool& pool;
+    UniformRing viewUniforms;
+    Shader program;
+    unsigned int buffers[BUFFER_COUNT];
+    uint32_t recordStep = 16;
+    bool countDraws = false;
+    std::vector<Entry> entries;
+    std::vector<Group> groups;
+    // MultiDrawGroupKey() -> group index
+    std::vector<uint32_t> groupOfKey;
+    bool dirty = true;
+    unsigned long long generation = 0;
+    Stats stats;
+
+    // ------------------------------------------------------------------------
+    CullObject makeCullObject(unsigned int index) const
+    {
+        const Entry& entry = entries[index];
+        const GeometryRange& range = pool.get(entry.mesh);
+        uint32_t groupIndex = groupOfKey[MultiDrawGroupKey(range)];
+        const Group& group = groups[groupIndex];
+        CullObject object;
+        object.sphere = entry.sphere;
+        object.command.count = range.indexCount;
+        object.command.instanceCount = 1;
+        object.command.firstIndex = range.firstIndex;
+        object.command.baseVertex = range.baseVertex;
+        object.command.baseInstance = 0;
+        object.group = groupIndex;
+        object.outputBase = group.outputBase;
+        object.padding = 0;
+        return object;
+    }
+    // the record with the mesh's dequantization, as MultiDrawBatch::add() does
+    // ------------------------------------------------------------------------
+    ObjectBlock makeRecord(unsigned int index) const
+    {
+        const Entry& entry = entries[index];
+        const GeometryRange& range = pool.get(entry.mesh);
+        ObjectBlock record = entry.object;
+        record.positionScale = Vec4(range.quantization.scale, 0.0f);
+        record.positionOffset = Vec4(range.quantization.offset, 0.0f);
+        return record;
+    }
+    // group the objects by arena and mode, give every group an output range
+    // whose records start at a valid SSBO offset, and (re)write all buffers
+    // ------------------------------------------------------------------------
+    void upload()
+    {
+        generation = pool.getGeneration();
+        groups.clear();
+        groupOfKey.assign(pool.getArenaCount() * MULTI_DRAW_MODES, 0);
+        std::vector<uint32_t> counts(groupOfKey.size(), 0);
+        for (const Entry& entry : entries)
+            counts[MultiDrawGroupKey(pool.get(entry.mesh))]++;
+        uint32_t outputSize = 0;
+        for (unsigned int key = 0; key < counts.size(); ++key)
+        {
+            if (counts[key] == 0)
+                continue;
+            Group group;
+            group.arena = key / MULTI_DRAW_MODES;
+            group.primitive = key % MULTI_DRAW_MODES;
+            group.outputBase = (outputSize + recordStep - 1) / recordStep * recordStep;
+            group.count = counts[key];
+            outputSize = group.outputBase + group.count;
+            groupOfKey[key] = (uint32_t)groups.size();
+            groups.push_back(group);
+        }
+
+        std::vector<CullObject> objects(entries.size());
+        std::vector<ObjectBlock> records(entries.size());
+        for (unsigned int i = 0; i < entries.size(); ++i)
+        {
+            objects[i] = makeCullObject(i);
+            records[i] = makeRecord(i);
+        }
+        GLStateCache& state = GLStateCache::instance();
+        auto store = [&state](unsigned int buffer, GLsizeiptr size, const void* data, GLenum usage)
+        {
+            state.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
+        };
+        store(buffers[OBJECTS], (GLsizeiptr)objects.size() * sizeof(CullObject), objects.data(), GL_STATIC_DRAW);
+        store(buffers[RECORDS], (GLsizeiptr)records.size() * sizeof(ObjectBlock), records.data(), GL_STATIC_DRAW);
+        store(buffers[COMMANDS], (GLsizeiptr)outputSize * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+        store(buffers[VISIBLE_RECORDS], (GLsizeiptr)outputSize * sizeof(ObjectBlock), NULL, GL_DYNAMIC_COPY);
+        store(buffers[COUNTERS], (GLsizeiptr)groups.size() * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+        store(buffers[VISIBILITY], (GLsizeiptr)entries.size() * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+        dirty = false;
+        stats.objects = (unsigned int)entries.size();
+        stats.groups = (unsigned int)groups.size();
+        stats.uploads++;
+    }
+};
+#endif
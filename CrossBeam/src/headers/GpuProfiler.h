@@ -0,0 +1,239 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "Profiler.h"
+
+// GPU pass timer. Each zone brackets its GL commands with two
+// glQueryCounter(GL_TIMESTAMP) queries; queries live in a ring of frames and
+// a frame's results are read back FRAMES_IN_FLIGHT - 1 frames later at most,
+// only once GL_QUERY_RESULT_AVAILABLE says so, so reading never waits on the
+// GPU. Finished zones are converted to profiler ticks and pushed onto a
+// "GPU" row of the CPU profiler: they show in its summary and next to the
+// CPU zones in the trace.
+//
+//     GpuProfiler gpuProfiler;
+//     while (running)
+//     {
+//         GPU_PROFILE_FRAME(gpuProfiler);     // before PROFILE_FRAME()
+//         { GPU_PROFILE_SCOPE(gpuProfiler, "Main pass"); ... draws ... }
+//     }
+//
+// Timestamps rather than GL_TIME_ELAPSED: elapsed queries cannot nest.
+// Compiles out with CROSSBEAM_SHIPPING like the CPU profiler.
+// ------------------------------------------------------------------------
+#ifndef CROSSBEAM_SHIPPING
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+
+class GpuProfiler
+{
+public:
+    // a frame's queries are reused after this many frames; results that are
+    // not back by then are dropped rather than waited for
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+    static const unsigned int MAX_ZONES = 64;
+    // the GPU clock is re-read against the CPU clock this often
+    static const unsigned int CALIBRATION_INTERVAL = 256;
+
+    GpuProfiler() : supported(isSupported()), timeline(Profiler::instance().registerGpuTimeline("GPU"))
+    {
+        if (!supported)
+            return;
+        for (Frame& frame : frames)
+        {
+            frame.queries.resize(MAX_ZONES * 2);
+            glGenQueries((GLsizei)frame.queries.size(), frame.queries.data());
+        }
+    }
+    // ------------------------------------------------------------------------
+    ~GpuProfiler()
+    {
+        if (!supported)
+            return;
+        for (Frame& frame : frames)
+            glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+    }
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // timestamp queries are core in 3.3
+    // ------------------------------------------------------------------------
+    static bool isSupported()
+    {
+        return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    }
+    // close the current frame, publish every earlier frame whose results are
+    // back and open the next one
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        if (!supported)
+            return;
+        Frame& current = frames[frameIndex % FRAMES_IN_FLIGHT];
+        current.pending = !current.zones.empty();
+        frameIndex++;
+
+        // oldest first; a frame is done only after the ones before it
+        for (unsigned long long index = frameIndex > FRAMES_IN_FLIGHT ? frameIndex - FRAMES_IN_FLIGHT : 0; index < frameIndex; ++index)
+        {
+            Frame& frame = frames[index % FRAMES_IN_FLIGHT];
+            if (!frame.pending)
+                continue;
+            if (!isAvailable(frame))
+                break;
+            publish(frame);
+        }
+
+        Frame& next = frames[frameIndex % FRAMES_IN_FLIGHT];
+        if (next.pending)
+            droppedFrames++;
+        next.pending = false;
+        next.zones.clear();
+        next.lastQuery = 0;
+        depth = 0;
+    }
+    // zone index in the current frame, -1 when it is full; prefer
+    // GPU_PROFILE_SCOPE
+    // ------------------------------------------------------------------------
+    int begin(const char* name)
+    {
+        Frame& frame = frames[frameIndex % FRAMES_IN_FLIGHT];
+        if (!supported || frame.zones.size() >= MAX_ZONES)
+            return -1;
+        int index = (int)frame.zones.size();
+        frame.zones.push_back(Zone{ name, depth++ });
+        query(frame, index * 2);
+        return index;
+    }
+    // ------------------------------------------------------------------------
+    void end(int index)
+    {
+        if (index < 0)
+            return;
+        depth--;
+        query(frames[frameIndex % FRAMES_IN_FLIGHT], index * 2 + 1);
+    }
+    // frames whose results were not back in time
+    // ------------------------------------------------------------------------
+    unsigned long long getDroppedFrames() const { return droppedFrames; }
+
+private:
+    struct Zone
+    {
+        // string literal, like CPU zone names
+        const char* name;
+        uint32_t depth;
+    };
+    struct Frame
+    {
+        // begin and end timestamp of zone i at 2i and 2i+1
+        std::vector<unsigned int> queries;
+        std::vector<Zone> zones;
+        unsigned int lastQuery = 0;
+        bool pending = false;
+    };
+
+    bool supported;
+    ProfileBuffer& timeline;
+    Frame frames[FRAMES_IN_FLIGHT];
+    unsigned long long frameIndex = 0;
+    unsigned long long droppedFrames = 0;
+    uint32_t depth = 0;
+    // GPU nanoseconds to profiler ticks
+    unsigned long long calibratedFrame = 0;
+    bool calibrated = false;
+    int64_t gpuAtCalibration = 0;
+    uint64_t ticksAtCalibration = 0;
+    double ticksPerNanosecond = 1.0;
+
+    // ------------------------------------------------------------------------
+    void query(Frame& frame, int slot)
+    {
+        frame.lastQuery = frame.queries[slot];
+        glQueryCounter(frame.lastQuery, GL_TIMESTAMP);
+    }
+    // queries complete in order, the last one issued nearly always decides
+    // ------------------------------------------------------------------------
+    bool isAvailable(const Frame& frame) const
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        for (size_t i = 0; available && i < frame.zones.size() * 2; ++i)
+            glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        return available != 0;
+    }
+    // results are known to be available, reading them does not wait
+    // ------------------------------------------------------------------------
+    void publish(Frame& frame)
+    {
+        if (!calibrated || frameIndex - calibratedFrame >= CALIBRATION_INTERVAL)
+            calibrate();
+        for (size_t i = 0; i < frame.zones.size(); ++i)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+            timeline.push(frame.zones[i].name, toTicks(begin), toTicks(end < begin ? begin : end), frame.zones[i].depth);
+        }
+        frame.pending = false;
+    }
+    // read the GPU clock (the time the GL server has reached, no pipeline
+    // wait) next to the CPU clock
+    // ------------------------------------------------------------------------
+    void calibrate()
+    {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        ticksAtCalibration = ProfileTimestamp();
+        gpuAtCalibration = gpuNow;
+        ticksPerNanosecond = Profiler::instance().ticksPerMicrosecond() / 1000.0;
+        calibratedFrame = frameIndex;
+        calibrated = true;
+    }
+    // ------------------------------------------------------------------------
+    uint64_t toTicks(GLuint64 gpuTime) const
+    {
+        double nanoseconds = (double)((int64_t)gpuTime - gpuAtCalibration);
+        return ticksAtCalibration + (uint64_t)(int64_t)(nanoseconds * ticksPerNanosecond);
+    }
+};
+
+// RAII GPU zone; use GPU_PROFILE_SCOPE so it compiles out with the rest
+// ------------------------------------------------------------------------
+class GpuProfileZone
+{
+public:
+    GpuProfileZone(GpuProfiler& profiler, const char* name) : profiler(profiler), index(profiler.begin(name)) {}
+    ~GpuProfileZone()
+    {
+        profiler.end(index);
+    }
+    GpuProfileZone(const GpuProfileZone&) = delete;
+    GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+private:
+    GpuProfiler& profiler;
+    int index;
+};
+
+#define GPU_PROFILE_SCOPE(profiler, name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(profiler, name)
+#define GPU_PROFILE_FRAME(profiler) (profiler).endFrame()
+
+#else
+
+// nothing to own in shipping builds
+// ------------------------------------------------------------------------
+class GpuProfiler
+{
+public:
+    GpuProfiler() {}
+};
+
+#define GPU_PROFILE_SCOPE(profiler, name) ((void)0)
+#define GPU_PROFILE_FRAME(profiler) ((void)0)
+
+#endif
+#endif
@@ -0,0 +1,34 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a, used for uniform name lookups and shader source keys
+// ------------------------------------------------------------------------
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// hash a block of bytes, continuing from a previous hash value so that
+// several pieces can be combined without concatenating them first
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+// ------------------------------------------------------------------------
+inline uint64_t HashString(const char* str, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    while (*str)
+    {
+        hash ^= static_cast<unsigned char>(*str++);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+#endif
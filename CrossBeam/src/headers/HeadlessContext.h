@@ -0,0 +1,188 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <cstring>
+#include <iostream>
+
+// EGL is the headless path wherever Mesa runs; Windows and macOS fall back
+// to a hidden GLFW window, which needs a display. The repo only ships the
+// Windows project, so the EGL path is not built from it: a Linux build is
+// the host's own (C++17, GLEW, GLFW, -lEGL -lGL -lpthread).
+#if !defined(_WIN32) && !defined(__APPLE__)
+#define CROSSBEAM_HEADLESS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// A current GL 4.x core context without a window, for benchmarks on build
+// hosts with no display or GPU (Mesa llvmpipe works). Tries, in order:
+//
+//     EGL surfaceless (EGL_MESA_platform_surfaceless), no display needed
+//     EGL on the default display with a 1x1 pbuffer
+//     a hidden GLFW window
+//
+// There is no default framebuffer to speak of: render into a RenderTarget.
+// Destroy it after every GL object made with it.
+// ------------------------------------------------------------------------
+class HeadlessContext
+{
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext()
+    {
+        release();
+    }
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // create and make current the newest core context up to major.minor
+    // down to 4.0; false when every path failed
+    // ------------------------------------------------------------------------
+    bool create(int major = 4, int minor = 5)
+    {
+#ifdef CROSSBEAM_HEADLESS_EGL
+        if (createEGL(major, minor, true) || createEGL(major, minor, false))
+            return true;
+#endif
+        return createHiddenWindow();
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+#ifdef CROSSBEAM_HEADLESS_EGL
+        if (display != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT)
+                eglDestroyContext(display, context);
+            if (surface != EGL_NO_SURFACE)
+                eglDestroySurface(display, surface);
+            eglTerminate(display);
+        }
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        surface = EGL_NO_SURFACE;
+#endif
+        if (window)
+            glfwDestroyWindow(window);
+        window = nullptr;
+    }
+    // how the context was made, for the log
+    // ------------------------------------------------------------------------
+    const std::string& getDescription() const { return description; }
+    // EGL contexts have no GLX display; GLEW reports that after loading the
+    // GL entry points, which is not a failure here
+    // ------------------------------------------------------------------------
+    bool acceptsGlewError(GLenum error) const
+    {
+#ifdef CROSSBEAM_HEADLESS_EGL
+        return error == GLEW_ERROR_NO_GLX_DISPLAY && context != EGL_NO_CONTEXT;
+#else
+        return false;
+#endif
+    }
+
+private:
+    std::string description;
+    GLFWwindow* window = nullptr;
+#ifdef CROSSBEAM_HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    // ------------------------------------------------------------------------
+    bool createEGL(int major, int minor, bool surfaceless)
+    {
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (surfaceless)
+        {
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (!clientExtensions || !strstr(clientExtensions, "EGL_MESA_platform_surfaceless") || !getPlatformDisplay)
+                return false;
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        else
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint eglMajor = 0, eglMinor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor) || !eglBindAPI(EGL_OPENGL_API))
+        {
+            release();
+            return false;
+        }
+
+        // surfaceless configs may not offer pbuffers, and need none
+        EGLint configAttributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            release();
+            return false;
+        }
+        for (int version = major * 10 + minor; version >= 40 && context == EGL_NO_CONTEXT; --version)
+        {
+            if (version % 10 > 6)
+                continue;
+            EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, version / 10,
+                EGL_CONTEXT_MINOR_VERSION, version % 10,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        }
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cout << "ERROR::HEADLESS_CONTEXT::EGL_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            release();
+            return false;
+        }
+        if (!surfaceless)
+        {
+            EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        }
+        if ((!surfaceless && surface == EGL_NO_SURFACE) || !eglMakeCurrent(display, surface, surface, context))
+        {
+            std::cout << "ERROR::HEADLESS_CONTEXT::EGL_MAKE_CURRENT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            release();
+            return false;
+        }
+        description = std::string("EGL ") + std::to_string(eglMajor) + "." + std::to_string(eglMinor) +
+            (surfaceless ? " surfaceless" : " pbuffer");
+        return true;
+    }
+#endif
+    // ------------------------------------------------------------------------
+    bool createHiddenWindow()
+    {
+        if (!glfwInit())
+            return false;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        window = glfwCreateWindow(1, 1, "CrossBeam (headless)", NULL, NULL);
+        if (!window)
+        {
+            std::cout << "ERROR::HEADLESS_CONTEXT::NO_CONTEXT, no EGL and no hidden window" << std::endl;
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+        description = "hidden GLFW window";
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,146 @@
+#ifndef HI_Z_PYRAMID_H
+#define HI_Z_PYRAMID_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "BasicShader.h"
+#include "GLStateCache.h"
+
+// Size of a pyramid level. Odd sizes round down, the last texel of a row or
+// column then also covers the extra texel of the level below.
+// ------------------------------------------------------------------------
+inline unsigned int HiZLevelSize(unsigned int size, unsigned int level)
+{
+    return std::max(size >> level, 1u);
+}
+// ------------------------------------------------------------------------
+inline unsigned int HiZLevelCount(unsigned int width, unsigned int height)
+{
+    unsigned int levels = 1;
+    while (HiZLevelSize(width, levels - 1) > 1 || HiZLevelSize(height, levels - 1) > 1)
+        levels++;
+    return levels;
+}
+
+// CPU copy of a Hi-Z pyramid: every texel holds the farthest depth of the
+// texels it covers. Reference for the compute reduction and GpuCulling.
+// ------------------------------------------------------------------------
+struct DepthPyramid
+{
+    unsigned int width = 0, height = 0;
+    std::vector<std::vector<float>> levels;
+
+    // depth is width * height window-space values, row 0 at the bottom
+    static DepthPyramid build(const float* depth, unsigned int width, unsigned int height)
+    {
+        DepthPyramid pyramid;
+        pyramid.width = width;
+        pyramid.height = height;
+        unsigned int levelCount = HiZLevelCount(width, height);
+        pyramid.levels.resize(levelCount);
+        pyramid.levels[0].assign(depth, depth + (size_t)width * height);
+        for (unsigned int level = 1; level < levelCount; ++level)
+        {
+            unsigned int previousWidth = HiZLevelSize(width, level - 1), previousHeight = HiZLevelSize(height, level - 1);
+            unsigned int levelWidth = HiZLevelSize(width, level), levelHeight = HiZLevelSize(height, level);
+            const std::vector<float>& previous = pyramid.levels[level - 1];
+            std::vector<float>& current = pyramid.levels[level];
+            current.resize((size_t)levelWidth * levelHeight);
+            for (unsigned int y = 0; y < levelHeight; ++y)
+                for (unsigned int x = 0; x < levelWidth; ++x)
+                {
+                    unsigned int lastX = x == levelWidth - 1 ? previousWidth - 1 : std::min(x * 2 + 1, previousWidth - 1);
+                    unsigned int lastY = y == levelHeight - 1 ? previousHeight - 1 : std::min(y * 2 + 1, previousHeight - 1);
+                    float farthest = 0.0f;
+                    for (unsigned int sy = y * 2; sy <= lastY; ++sy)
+                        for (unsigned int sx = x * 2; sx <= lastX; ++sx)
+                            farthest = std::max(farthest, previous[(size_t)sy * previousWidth + sx]);
+                    current[(size_t)y * levelWidth + x] = farthest;
+                }
+        }
+        return pyramid;
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getLevelCount() const { return (unsigned int)levels.size(); }
+    float fetch(unsigned int level, unsigned int x, unsigned int y) const
+    {
+        return levels[level][(size_t)y * HiZLevelSize(width, level) + x];
+    }
+};
+
+// GPU Hi-Z pyramid: an R32F texture with a full mip chain, rebuilt from a
+// depth texture by res/shaders/HiZReduceCompute.shader (one dispatch per
+// level). Needs compute shaders and image load/store (GL 4.3).
+//
+//     hiZ.build(depthTexture);  // after the depth pre-pass or last frame's depth
+//     culling.cull(view, &hiZ);
+// ------------------------------------------------------------------------
+class HiZPyramid
+{
+public:
+    HiZPyramid(unsigned int width, unsigned int height)
+        : width(width), height(height), levelCount(HiZLevelCount(width, height)),
+        reduce(Shader::compute("res/shaders/HiZReduceCompute.shader"))
+    {
+        glGenTextures(1, &texture);
+        GLStateCache::instance().bindTexture(0, GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, (GLsizei)levelCount, GL_R32F, (GLsizei)width, (GLsizei)height);
+        // only ever read with texelFetch
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        levelHandle = reduce.uniform("uLevel");
+    }
+    // ------------------------------------------------------------------------
+    ~HiZPyramid()
+    {
+        glDeleteTextures(1, &texture);
+        GLStateCache::instance().forgetProgram(reduce.ID);
+        glDeleteProgram(reduce.ID);
+    }
+    HiZPyramid(const HiZPyramid&) = delete;
+    HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+    // ------------------------------------------------------------------------
+    static bool isSupported()
+    {
+        return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_image_load_store && GLEW_ARB_texture_storage);
+    }
+    // reduce a depth texture of the pyramid's size into every level
+    // ------------------------------------------------------------------------
+    void build(unsigned int depthTexture)
+    {
+        GLStateCache& state = GLStateCache::instance();
+        reduce.use();
+        state.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+        for (unsigned int level = 0; level < levelCount; ++level)
+        {
+            reduce.setInt(levelHandle, (int)level);
+            // level 0 copies the depth texture, the rest read the level below
+            if (level > 0)
+                glBindImageTexture(0, texture, (GLint)level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, texture, (GLint)level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            GLuint groupsX = (HiZLevelSize(width, level) + 7) / 8, groupsY = (HiZLevelSize(height, level) + 7) / 8;
+            glDispatchCompute(groupsX, groupsY, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        // the culling pass reads the result with texelFetch
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getTexture() const { return texture; }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    unsigned int getLevelCount() const { return levelCount; }
+
+private:
+    unsigned int width, height, levelCount;
+    unsigned int texture = 0;
+    Shader reduce;
+    UniformHandle levelHandle;
+};
+#endif
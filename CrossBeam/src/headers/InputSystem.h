@@ -0,0 +1,286 @@
+#ifndef INPUT_SYSTEM_H
+#define INPUT_SYSTEM_H
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Input codes: GLFW key codes, then the mouse buttons after GLFW_KEY_LAST.
+// ------------------------------------------------------------------------
+const int INPUT_MOUSE_FIRST = GLFW_KEY_LAST + 1;
+const int INPUT_CODE_COUNT = INPUT_MOUSE_FIRST + GLFW_MOUSE_BUTTON_LAST + 1;
+
+inline int MouseButtonCode(int button) { return INPUT_MOUSE_FIRST + button; }
+
+enum InputEventType
+{
+    INPUT_EVENT_BUTTON,
+    // code is the Unicode code point
+    INPUT_EVENT_CHAR,
+    // x and y in screen coordinates
+    INPUT_EVENT_CURSOR
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    int code;
+    // GLFW_PRESS or GLFW_RELEASE for buttons (repeats are not queued)
+    int action;
+    int mods;
+    double x, y;
+    // steady_clock nanoseconds when GLFW delivered it
+    int64_t timestamp;
+};
+
+// Single-producer single-consumer ring of input events: the GLFW callbacks
+// push, update() drains. Events that find the ring full until the next
+// drain are dropped and counted. Cursor and text events stop BUTTON_RESERVE
+// slots short of full, so a fast mouse during a long frame loses cursor
+// samples rather than the release that ends a held key.
+// ------------------------------------------------------------------------
+class InputQueue
+{
+public:
+    static const uint32_t CAPACITY = 1024;
+    // slots only button events may take
+    static const uint32_t BUTTON_RESERVE = 256;
+
+    InputQueue() : events(CAPACITY) {}
+
+    // ------------------------------------------------------------------------
+    void push(const InputEvent& event)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint32_t limit = event.type == INPUT_EVENT_BUTTON ? CAPACITY : CAPACITY - BUTTON_RESERVE;
+        if (h - tail.load(std::memory_order_acquire) >= limit)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & (CAPACITY - 1)] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    void drain(Function function)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (; t < h; ++t)
+            function(events[t & (CAPACITY - 1)]);
+        tail.store(h, std::memory_order_release);
+    }
+    // ------------------------------------------------------------------------
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<InputEvent> events;
+    alignas(64) std::atomic<uint64_t> head{ 0 };
+    alignas(64) std::atomic<uint64_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+// Event-driven input. GLFW callbacks queue timestamped key, mouse button,
+// character and cursor events; update() applies them once per frame, so
+// its cost follows the number of events, not the number of bound keys.
+// Buttons and actions have held state plus pressed / released edges that
+// are true for exactly the frame they happened in: a toggle on pressed()
+// fires once per press however long the key is held. A press and release
+// within one frame report both edges.
+//
+//     InputSystem input;
+//     input.attach(window);
+//     input.bindAction(ACTION_JUMP, GLFW_KEY_SPACE);
+//     input.bindAction(ACTION_JUMP, MouseButtonCode(GLFW_MOUSE_BUTTON_LEFT));
+//     ...
+//     glfwPollEvents();
+//     input.update();
+//     if (input.actionPressed(ACTION_JUMP)) ...
+// ------------------------------------------------------------------------
+class InputSystem
+{
+public:
+    InputSystem() : buttons(INPUT_CODE_COUNT, 0), bindings(INPUT_CODE_COUNT) {}
+    ~InputSystem()
+    {
+        detach();
+    }
+    InputSystem(const InputSystem&) = delete;
+    InputSystem& operator=(const InputSystem&) = delete;
+
+    // install the callbacks; takes the window's user pointer
+    // ------------------------------------------------------------------------
+    void attach(GLFWwindow* target)
+    {
+        detach();
+        window = target;
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, KeyCallback);
+        glfwSetMouseButtonCallback(window, MouseButtonCallback);
+        glfwSetCharCallback(window, CharCallback);
+        glfwSetCursorPosCallback(window, CursorCallback);
+    }
+    // ------------------------------------------------------------------------
+    void detach()
+    {
+        if (!window)
+            return;
+        glfwSetKeyCallback(window, NULL);
+        glfwSetMouseButtonCallback(window, NULL);
+        glfwSetCharCallback(window, NULL);
+        glfwSetCursorPosCallback(window, NULL);
+        glfwSetWindowUserPointer(window, NULL);
+        window = nullptr;
+    }
+    // map a key or mouse button (MouseButtonCode) to an action; an action may
+    // have several, it is held while any of them is
+    // ------------------------------------------------------------------------
+    void bindAction(int action, int code)
+    {
+        if (code < 0 || code >= INPUT_CODE_COUNT || action < 0)
+            return;
+        if (action >= (int)actions.size())
+            actions.resize(action + 1);
+        bindings[code].push_back(action);
+        if (buttons[code] & BUTTON_DOWN)
+            actions[action].held++;
+    }
+    // apply the events queued since the last call: clears last frame's edges,
+    // then sets this frame's
+    // ------------------------------------------------------------------------
+    void update()
+    {
+        for (int code : changedButtons)
+            buttons[code] &= BUTTON_DOWN;
+        for (int action : changedActions)
+            actions[action].edges = 0;
+        changedButtons.clear();
+        changedActions.clear();
+        frameEvents.clear();
+        text.clear();
+
+        queue.drain([this](const InputEvent& event)
+        {
+            frameEvents.push_back(event);
+            if (event.type == INPUT_EVENT_CHAR)
+                text.push_back((unsigned int)event.code);
+            else if (event.type == INPUT_EVENT_CURSOR)
+            {
+                cursorX = event.x;
+                cursorY = event.y;
+            }
+            else
+                applyButton(event.code, event.action == GLFW_PRESS);
+        });
+    }
+
+    // ------------------------------------------------------------------------
+    bool isDown(int code) const { return valid(code) && (buttons[code] & BUTTON_DOWN) != 0; }
+    bool wasPressed(int code) const { return valid(code) && (buttons[code] & BUTTON_PRESSED) != 0; }
+    bool wasReleased(int code) const { return valid(code) && (buttons[code] & BUTTON_RELEASED) != 0; }
+    // ------------------------------------------------------------------------
+    bool actionDown(int action) const { return action >= 0 && action < (int)actions.size() && actions[action].held > 0; }
+    bool actionPressed(int action) const { return action >= 0 && action < (int)actions.size() && (actions[action].edges & BUTTON_PRESSED) != 0; }
+    bool actionReleased(int action) const { return action >= 0 && action < (int)actions.size() && (actions[action].edges & BUTTON_RELEASED) != 0; }
+    // this frame's events in arrival order, and its typed text as code points
+    // ------------------------------------------------------------------------
+    const std::vector<InputEvent>& getEvents() const { return frameEvents; }
+    const std::vector<unsigned int>& getText() const { return text; }
+    double getCursorX() const { return cursorX; }
+    double getCursorY() const { return cursorY; }
+    uint64_t getDroppedEvents() const { return queue.getDropped(); }
+
+    // the callbacks' producer side, also for injecting events (replays, tests)
+    // ------------------------------------------------------------------------
+    void push(InputEventType type, int code, int action, int mods, double x = 0.0, double y = 0.0)
+    {
+        InputEvent event;
+        event.type = type;
+        event.code = code;
+        event.action = action;
+        event.mods = mods;
+        event.x = x;
+        event.y = y;
+        event.timestamp = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        queue.push(event);
+    }
+
+private:
+    enum ButtonBits : uint8_t
+    {
+        BUTTON_DOWN = 1,
+        BUTTON_PRESSED = 2,
+        BUTTON_RELEASED = 4
+    };
+    struct Action
+    {
+        // bound buttons currently down
+        int held = 0;
+        uint8_t edges = 0;
+    };
+
+    GLFWwindow* window = nullptr;
+    InputQueue queue;
+    std::vector<uint8_t> buttons;
+    // actions bound to each code
+    std::vector<std::vector<int>> bindings;
+    std::vector<Action> actions;
+    // whose edges to clear on the next update()
+    std::vector<int> changedButtons;
+    std::vector<int> changedActions;
+    std::vector<InputEvent> frameEvents;
+    std::vector<unsigned int> text;
+    double cursorX = 0.0, cursorY = 0.0;
+
+    // ------------------------------------------------------------------------
+    static bool valid(int code) { return code >= 0 && code < INPUT_CODE_COUNT; }
+    // ------------------------------------------------------------------------
+    void applyButton(int code, bool down)
+    {
+        if (!valid(code) || ((buttons[code] & BUTTON_DOWN) != 0) == down)
+            return;
+        if (!(buttons[code] & (BUTTON_PRESSED | BUTTON_RELEASED)))
+            changedButtons.push_back(code);
+        buttons[code] = (uint8_t)((buttons[code] & ~BUTTON_DOWN) | (down ? BUTTON_DOWN | BUTTON_PRESSED : BUTTON_RELEASED));
+        for (int index : bindings[code])
+        {
+            Action& action = actions[index];
+            action.held += down ? 1 : -1;
+            // edges only when the first button goes down or the last comes up
+            if (action.held != (down ? 1 : 0))
+                continue;
+            if (!action.edges)
+                changedActions.push_back(index);
+            action.edges |= down ? BUTTON_PRESSED : BUTTON_RELEASED;
+        }
+    }
+    // ------------------------------------------------------------------------
+    static InputSystem* from(GLFWwindow* window)
+    {
+        return (InputSystem*)glfwGetWindowUserPointer(window);
+    }
+    static void KeyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int mods)
+    {
+        // unknown keys (GLFW_KEY_UNKNOWN) and auto-repeats carry no state change
+        if (key >= 0 && action != GLFW_REPEAT)
+            from(window)->push(INPUT_EVENT_BUTTON, key, action, mods);
+    }
+    static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+    {
+        from(window)->push(INPUT_EVENT_BUTTON, MouseButtonCode(button), action, mods);
+    }
+    static void CharCallback(GLFWwindow* window, unsigned int codepoint)
+    {
+        from(window)->push(INPUT_EVENT_CHAR, (int)codepoint, 0, 0);
+    }
+    static void CursorCallback(GLFWwindow* window, double x, double y)
+    {
+        from(window)->push(INPUT_EVENT_CURSOR, 0, 0, 0, x, y);
+    }
+};
+#endif
@@ -0,0 +1,209 @@
+#ifndef INSTANCE_BATCHER_H
+#define INSTANCE_BATCHER_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "Math.h"
+#include "GeometryPool.h"
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+#include "GLStateCache.h"
+
+// Per-instance vertex attributes, read with divisor 1 by the INSTANCING
+// shader variant: the model matrix takes locations 8-11, the color 12.
+// The instance transform is applied after the object block's model.
+// ------------------------------------------------------------------------
+struct InstanceData
+{
+    Mat4 model;
+    Vec4 color;
+};
+static_assert(sizeof(InstanceData) == 80, "InstanceData must match the instance attribute layout");
+
+const unsigned int INSTANCE_ATTRIBUTE_MODEL = 8;
+const unsigned int INSTANCE_ATTRIBUTE_COLOR = 12;
+
+// Groups instances of the same mesh + material as they are added and draws
+// each group with one glDrawElementsInstancedBaseVertexBaseInstance. All
+// instance data of a frame goes into one StreamBuffer whose attributes are
+// set up once per arena VAO; baseInstance selects a group's range, so
+// nothing is re-pointed between draws. Drivers without GL_ARB_base_instance
+// (GL 4.2) re-point the attributes per group instead.
+//
+//     batcher.begin();
+//     batcher.add(rock, stoneMaterial, instance);  // any order
+//     batcher.submit(objectUniforms, bindMaterial);
+//     batcher.end();
+// ------------------------------------------------------------------------
+class InstanceBatcher
+{
+public:
+    struct Stats
+    {
+        unsigned int instances = 0;
+        unsigned int batches = 0;
+    };
+
+    InstanceBatcher(GeometryPool& pool, unsigned int maxInstances)
+        : pool(pool), maxInstances(maxInstances),
+        stream(GL_ARRAY_BUFFER, (GLsizeiptr)maxInstances * sizeof(InstanceData), 3, sizeof(InstanceData))
+    {
+        baseInstance = GLEW_ARB_base_instance || GLEW_VERSION_4_2;
+    }
+    // ------------------------------------------------------------------------
+    void begin()
+    {
+        for (unsigned int b = 0; b < usedBatches; ++b)
+            batches[b].instances.clear();
+        usedBatches = 0;
+        lookup.clear();
+        instanceCount = 0;
+        stream.beginFrame();
+        stats = Stats();
+    }
+    // ------------------------------------------------------------------------
+    void add(GeometryHandle mesh, unsigned int material, const InstanceData& instance)
+    {
+        if (instanceCount >= maxInstances)
+        {
+            std::cout << "ERROR::INSTANCE_BATCHER::FULL, dropping instances past " << maxInstances << std::endl;
+            return;
+        }
+        uint64_t key = ((uint64_t)material << 32) | (uint32_t)mesh.slot;
+        auto found = lookup.find(key);
+        unsigned int index;
+        if (found != lookup.end())
+            index = found->second;
+        else
+        {
+            index = usedBatches++;
+            if (index == batches.size())
+                batches.push_back(Batch());
+            batches[index].mesh = mesh;
+            batches[index].material = material;
+            lookup[key] = index;
+        }
+        batches[index].instances.push_back(instance);
+        instanceCount++;
+    }
+    // draw every batch, sorted by material so bindMaterial runs once per
+    // material; objectUniforms carries the mesh's dequantization
+    // ------------------------------------------------------------------------
+    void submit(UniformRing& objectUniforms, const std::function<void(unsigned int)>& bindMaterial = nullptr)
+    {
+        std::vector<unsigned int> order(usedBatches);
+        for (unsigned int b = 0; b < usedBatches; ++b)
+            order[b] = b;
+        std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+        {
+            if (batches[a].material != batches[b].material)
+                return batches[a].material < batches[b].material;
+            return batches[a].mesh.slot < batches[b].mesh.slot;
+        });
+
+        bool firstBatch = true;
+        unsigned int boundMaterial = 0;
+        for (unsigned int b : order)
+        {
+            const Batch& batch = batches[b];
+            const GeometryRange& range = pool.get(batch.mesh);
+            GLsizeiptr size = (GLsizeiptr)batch.instances.size() * sizeof(InstanceData);
+            // aligned to whole instances so the offset is an instance index
+            GLintptr offset = stream.write(batch.instances.data(), size, sizeof(InstanceData));
+
+            if (bindMaterial && (firstBatch || batch.material != boundMaterial))
+                bindMaterial(batch.material);
+            boundMaterial = batch.material;
+            firstBatch = false;
+
+            ObjectBlock object;
+            object.model = Mat4::identity();
+            object.color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+            object.positionScale = Vec4(range.quantization.scale, 0.0f);
+            object.positionOffset = Vec4(range.quantization.offset, 0.0f);
+            objectUniforms.pushAndBind(object);
+
+            pool.bind(range.arena);
+            setupInstanceAttributes(range.arena, baseInstance ? 0 : offset);
+            const void* indices = (const void*)((size_t)range.firstIndex * pool.indexSize());
+            GLsizei count = (GLsizei)batch.instances.size();
+            if (baseInstance)
+                glDrawElementsInstancedBaseVertexBaseInstance(range.primitive, range.indexCount, pool.getIndexType(), indices,
+                    count, range.baseVertex, (GLuint)(offset / sizeof(InstanceData)));
+            else
+                glDrawElementsInstancedBaseVertex(range.primitive, range.indexCount, pool.getIndexType(), indices,
+                    count, range.baseVertex);
+            stats.instances += (unsigned int)count;
+            stats.batches++;
+        }
+    }
+    // fence this frame's instance data; call after the pass
+    // ------------------------------------------------------------------------
+    void end()
+    {
+        stream.endFrame();
+    }
+    // ------------------------------------------------------------------------
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Batch
+    {
+        GeometryHandle mesh;
+        unsigned int material = 0;
+        std::vector<InstanceData> instances;
+    };
+
+    GeometryPool& pool;
+    unsigned int maxInstances;
+    StreamBuffer stream;
+    bool baseInstance = false;
+    // batches are reused between frames to keep their instance storage
+    std::vector<Batch> batches;
+    unsigned int usedBatches = 0;
+    unsigned int instanceCount = 0;
+    std::unordered_map<uint64_t, unsigned int> lookup;
+    // VAO each arena had when its instance attributes were set up
+    std::vector<unsigned int> configuredVAOs;
+    // stream buffer they were set up with
+    unsigned int configuredBuffer = 0;
+    Stats stats;
+
+    // point the instance attributes of the bound arena VAO at the stream;
+    // with base instances this only happens once per VAO
+    void setupInstanceAttributes(unsigned int arena, GLintptr offset)
+    {
+        if (configuredVAOs.size() <= arena)
+            configuredVAOs.resize(arena + 1, 0);
+        // a grown stream is a new buffer, every VAO has to point at it again
+        if (configuredBuffer != stream.ID)
+            std::fill(configuredVAOs.begin(), configuredVAOs.end(), 0u);
+        configuredBuffer = stream.ID;
+        unsigned int VAO = pool.getVertexArray(arena);
+        if (baseInstance && configuredVAOs[arena] == VAO)
+            return;
+        configuredVAOs[arena] = VAO;
+
+        GLStateCache::instance().bindBuffer(GL_ARRAY_BUFFER, stream.ID);
+        for (unsigned int column = 0; column < 4; ++column)
+        {
+            unsigned int location = INSTANCE_ATTRIBUTE_MODEL + column;
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const void*)(offset + column * sizeof(Vec4)));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const void*)(offset + offsetof(InstanceData, color)));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE_COLOR, 1);
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_COLOR);
+    }
+};
+#endif
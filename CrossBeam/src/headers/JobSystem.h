@@ -0,0 +1,330 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+struct Job;
+
+// Counts unfinished jobs. A job run with a counter increments it and
+// decrements it when done; wait() on it blocks until it reaches zero, and
+// jobs queued with it as their dependency start once it does.
+// ------------------------------------------------------------------------
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    // true once the last job has also let go of the counter, so it may be
+    // destroyed right after
+    bool isDone()
+    {
+        if (pending.load(std::memory_order_acquire) != 0)
+            return false;
+        std::lock_guard<std::mutex> guard(lock);
+        return pending.load(std::memory_order_relaxed) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{ 0 };
+    // finishing jobs decrement under the lock; jobs waiting for this counter
+    // are released by whoever brings it to zero
+    std::mutex lock;
+    std::vector<Job*> continuations;
+};
+
+struct Job
+{
+    std::function<void()> function;
+    JobCounter* counter = nullptr;
+};
+
+// Chase-Lev work-stealing deque (the C11 version of Le et al. 2013): the
+// owning thread pushes and pops at the bottom, any thread steals from the
+// top. Fixed capacity; push() fails when full.
+// ------------------------------------------------------------------------
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(unsigned int capacity = 4096) : buffer(capacity), mask((int64_t)capacity - 1)
+    {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+            std::cout << "ERROR::WORK_STEALING_DEQUE::CAPACITY_NOT_POWER_OF_TWO " << capacity << std::endl;
+    }
+    // owner only
+    // ------------------------------------------------------------------------
+    bool push(Job* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > mask)
+            return false;
+        buffer[b & mask].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+    // owner only; newest job first
+    // ------------------------------------------------------------------------
+    Job* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // last job: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+    // any thread; oldest job first
+    // ------------------------------------------------------------------------
+    Job* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        Job* job = buffer[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+private:
+    std::vector<std::atomic<Job*>> buffer;
+    int64_t mask;
+    // owner and thieves touch different ends, keep them on different lines
+    alignas(64) std::atomic<int64_t> top{ 0 };
+    alignas(64) std::atomic<int64_t> bottom{ 0 };
+};
+
+// Fixed pool of worker threads, each with its own WorkStealingDeque. The
+// thread that creates the system takes part as thread 0: it queues jobs
+// and runs them while it waits. Jobs may queue more jobs; idle workers
+// steal from the others and sleep when nothing is queued anywhere.
+//
+//     JobCounter transforms, culling;
+//     jobs.parallelFor(objects.size(), [&](size_t begin, size_t end) { ... }, &transforms);
+//     jobs.run([&]() { cullAll(); }, &culling, &transforms);  // after the transforms
+//     jobs.wait(culling);                                     // helps instead of blocking
+//
+// run() and wait() must be called from the owning thread or from inside a
+// job. Only one JobSystem per owning thread at a time.
+// ------------------------------------------------------------------------
+class JobSystem
+{
+public:
+    JobSystem(unsigned int workerCount = DefaultWorkerCount())
+    {
+        for (unsigned int i = 0; i < workerCount + 1; ++i)
+            deques.emplace_back(new WorkStealingDeque());
+        threadIndex() = 0;
+        currentSystem() = this;
+        for (unsigned int i = 0; i < workerCount; ++i)
+            workers.emplace_back([this, i]() { workerLoop(i + 1); });
+    }
+    // ------------------------------------------------------------------------
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        if (currentSystem() == this)
+            currentSystem() = nullptr;
+    }
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // one worker per core besides the owning thread
+    // ------------------------------------------------------------------------
+    static unsigned int DefaultWorkerCount()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+    // queue a job; with a dependency it starts once that counter is done
+    // ------------------------------------------------------------------------
+    void run(std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr)
+    {
+        Job* job = new Job();
+        job->function = std::move(function);
+        job->counter = counter;
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        if (dependency)
+        {
+            std::lock_guard<std::mutex> lock(dependency->lock);
+            if (dependency->pending.load(std::memory_order_relaxed) != 0)
+            {
+                dependency->continuations.push_back(job);
+                return;
+            }
+        }
+        schedule(job);
+    }
+    // split [0, count) into chunks run as jobs; grain 0 picks a chunk size
+    // that gives every thread a few chunks to balance with. Without a
+    // counter it waits for the chunks, helping.
+    // ------------------------------------------------------------------------
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& function, JobCounter* counter = nullptr,
+        size_t grain = 0)
+    {
+        if (count == 0)
+            return;
+        if (grain == 0)
+            grain = std::max<size_t>(1, count / (getThreadCount() * 4));
+        JobCounter local;
+        JobCounter* done = counter ? counter : &local;
+        // the chunks copy the function, a caller's temporary may be gone by then
+        std::shared_ptr<std::function<void(size_t, size_t)>> shared = std::make_shared<std::function<void(size_t, size_t)>>(function);
+        for (size_t begin = 0; begin < count; begin += grain)
+        {
+            size_t end = std::min(begin + grain, count);
+            run([shared, begin, end]() { (*shared)(begin, end); }, done);
+        }
+        if (!counter)
+            wait(local);
+    }
+    // run queued jobs until the counter is done
+    // ------------------------------------------------------------------------
+    void wait(JobCounter& counter)
+    {
+        unsigned int self = threadIndex();
+        while (!counter.isDone())
+        {
+            Job* job = findJob(self);
+            if (job)
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getWorkerCount() const { return (unsigned int)workers.size(); }
+    unsigned int getThreadCount() const { return (unsigned int)deques.size(); }
+
+private:
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+    std::vector<std::thread> workers;
+    // jobs sitting in deques, so sleepers know when to wake
+    std::atomic<int> queued{ 0 };
+    std::atomic<int> sleeping{ 0 };
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static unsigned int& threadIndex()
+    {
+        static thread_local unsigned int index = 0;
+        return index;
+    }
+    static JobSystem*& currentSystem()
+    {
+        static thread_local JobSystem* system = nullptr;
+        return system;
+    }
+    // ------------------------------------------------------------------------
+    void schedule(Job* job)
+    {
+        if (currentSystem() != this)
+        {
+            std::cout << "ERROR::JOB_SYSTEM::FOREIGN_THREAD, running job inline" << std::endl;
+            execute(job);
+            return;
+        }
+        queued.fetch_add(1);
+        if (!deques[threadIndex()]->push(job))
+        {
+            // full: cheaper to run it now than to grow
+            queued.fetch_sub(1);
+            execute(job);
+            return;
+        }
+        if (sleeping.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            wake.notify_one();
+        }
+    }
+    // own deque first, then steal round-robin starting after ourselves
+    // ------------------------------------------------------------------------
+    Job* findJob(unsigned int self)
+    {
+        Job* job = deques[self]->pop();
+        for (unsigned int i = 1; !job && i < deques.size(); ++i)
+            job = deques[(self + i) % deques.size()]->steal();
+        if (job)
+            queued.fetch_sub(1);
+        return job;
+    }
+    // ------------------------------------------------------------------------
+    void execute(Job* job)
+    {
+        job->function();
+        JobCounter* counter = job->counter;
+        delete job;
+        if (!counter)
+            return;
+        std::vector<Job*> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->lock);
+            if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(counter->continuations);
+        }
+        for (Job* continuation : ready)
+            schedule(continuation);
+    }
+    // ------------------------------------------------------------------------
+    void workerLoop(unsigned int index)
+    {
+        threadIndex() = index;
+        currentSystem() = this;
+        for (;;)
+        {
+            Job* job = findJob(index);
+            if (job)
+            {
+                execute(job);
+                continue;
+            }
+            // a job can be between push and the queued count, spin briefly first
+            std::this_thread::yield();
+            if (queued.load() > 0)
+                continue;
+            std::unique_lock<std::mutex> lock(sleepLock);
+            sleeping.fetch_add(1);
+            wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+            if (stopping)
+                return;
+        }
+    }
+};
+#endif
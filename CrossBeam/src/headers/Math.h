@@ -0,0 +1,121 @@
+#ifndef MATH_H
+#define MATH_H
+
+#include <cmath>
+
+// Minimal vector/matrix types. Matrices are column-major like GLSL, so they
+// can be copied straight into std140 blocks and glUniformMatrix4fv.
+// ------------------------------------------------------------------------
+struct Vec3
+{
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+
+    Vec3() {}
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3 operator+(const Vec3& o) const { return Vec3(x + o.x, y + o.y, z + o.z); }
+    Vec3 operator-(const Vec3& o) const { return Vec3(x - o.x, y - o.y, z - o.z); }
+    Vec3 operator*(float s) const { return Vec3(x * s, y * s, z * s); }
+};
+
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3& a, const Vec3& b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline float Length(const Vec3& v) { return std::sqrt(Dot(v, v)); }
+inline Vec3 Normalize(const Vec3& v) { float l = Length(v); return l > 0.0f ? v * (1.0f / l) : v; }
+
+// ------------------------------------------------------------------------
+struct Vec4
+{
+    float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+
+    Vec4() {}
+    Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+};
+
+// ------------------------------------------------------------------------
+struct Mat4
+{
+    // m[column * 4 + row]
+    float m[16];
+
+    static Mat4 identity()
+    {
+        Mat4 r;
+        for (int i = 0; i < 16; ++i)
+            r.m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+        return r;
+    }
+    // ------------------------------------------------------------------------
+    static Mat4 translation(const Vec3& t)
+    {
+        Mat4 r = identity();
+        r.m[12] = t.x;
+        r.m[13] = t.y;
+        r.m[14] = t.z;
+        return r;
+    }
+    // ------------------------------------------------------------------------
+    static Mat4 scale(const Vec3& s)
+    {
+        Mat4 r = identity();
+        r.m[0] = s.x;
+        r.m[5] = s.y;
+        r.m[10] = s.z;
+        return r;
+    }
+    // right-handed, depth mapped to [-1, 1] like glFrustum
+    // ------------------------------------------------------------------------
+    static Mat4 perspective(float fovY, float aspect, float nearZ, float farZ)
+    {
+        Mat4 r;
+        for (int i = 0; i < 16; ++i)
+            r.m[i] = 0.0f;
+        float f = 1.0f / std::tan(fovY * 0.5f);
+        r.m[0] = f / aspect;
+        r.m[5] = f;
+        r.m[10] = (farZ + nearZ) / (nearZ - farZ);
+        r.m[11] = -1.0f;
+        r.m[14] = 2.0f * farZ * nearZ / (nearZ - farZ);
+        return r;
+    }
+    // ------------------------------------------------------------------------
+    static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up)
+    {
+        Vec3 f = Normalize(target - eye);
+        Vec3 s = Normalize(Cross(f, up));
+        Vec3 u = Cross(s, f);
+        Mat4 r = identity();
+        r.m[0] = s.x; r.m[4] = s.y; r.m[8] = s.z;
+        r.m[1] = u.x; r.m[5] = u.y; r.m[9] = u.z;
+        r.m[2] = -f.x; r.m[6] = -f.y; r.m[10] = -f.z;
+        r.m[12] = -Dot(s, eye);
+        r.m[13] = -Dot(u, eye);
+        r.m[14] = Dot(f, eye);
+        return r;
+    }
+    // ------------------------------------------------------------------------
+    Mat4 operator*(const Mat4& o) const
+    {
+        Mat4 r;
+        for (int c = 0; c < 4; ++c)
+            for (int row = 0; row < 4; ++row)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k)
+                    sum += m[k * 4 + row] * o.m[c * 4 + k];
+                r.m[c * 4 + row] = sum;
+            }
+        return r;
+    }
+    // ------------------------------------------------------------------------
+    Vec4 operator*(const Vec4& v) const
+    {
+        return Vec4(
+            m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * v.w,
+            m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * v.w,
+            m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * v.w,
+            m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15] * v.w);
+    }
+};
+#endif
@@ -0,0 +1,343 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Import-time index/vertex reordering for indexed triangle lists:
+//
+//     OptimizeOverdraw(indices, positions, stride, count);   // cache order, then cluster order
+//     OptimizeVertexFetch(vertices, vertexSize, indices);    // pre-transform fetch
+//
+// OptimizeMesh runs both. The cache pass is Tipsify (Sander, Nehab & Barczak
+// 2007): linear time, and the points where it runs into a dead end give the
+// cluster boundaries the overdraw pass sorts by. Use OptimizeVertexCache on
+// its own when overdraw does not matter (e.g. depth pre-passed geometry).
+
+// Post-transform cache statistics for a FIFO cache of the given size.
+// ACMR = transformed vertices per triangle (0.5 is ideal on a closed grid,
+// 3 is no reuse at all); ATVR = transformed per unique vertex (1 is ideal).
+// ------------------------------------------------------------------------
+struct VertexCacheStats
+{
+    unsigned int transformed = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+inline VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, unsigned int vertexCount, unsigned int cacheSize = 16)
+{
+    VertexCacheStats stats;
+    // a vertex is in the FIFO while fewer than cacheSize misses happened after it entered
+    std::vector<unsigned int> entered(vertexCount, 0);
+    std::vector<char> used(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    unsigned int unique = 0;
+    for (uint32_t index : indices)
+    {
+        if (timestamp - entered[index] > cacheSize)
+        {
+            entered[index] = timestamp++;
+            stats.transformed++;
+        }
+        if (!used[index])
+        {
+            used[index] = 1;
+            unique++;
+        }
+    }
+    size_t triangles = indices.size() / 3;
+    stats.acmr = triangles ? (float)stats.transformed / triangles : 0.0f;
+    stats.atvr = unique ? (float)stats.transformed / unique : 0.0f;
+    return stats;
+}
+
+// Vertex -> triangle adjacency in compressed rows
+// ------------------------------------------------------------------------
+struct TriangleAdjacency
+{
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> triangles;
+
+    TriangleAdjacency(const std::vector<uint32_t>& indices, unsigned int vertexCount)
+        : offsets(vertexCount + 1, 0), triangles(indices.size())
+    {
+        for (uint32_t index : indices)
+            offsets[index + 1]++;
+        for (unsigned int v = 0; v < vertexCount; ++v)
+            offsets[v + 1] += offsets[v];
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+    unsigned int count(unsigned int vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+};
+
+// Reorder triangles for the post-transform cache. If clusters is given it
+// receives the first triangle of every cluster (Tipsify's dead-end points).
+// ------------------------------------------------------------------------
+inline void OptimizeVertexCache(std::vector<uint32_t>& indices, unsigned int vertexCount,
+    unsigned int cacheSize = 16, std::vector<unsigned int>* clusters = nullptr)
+{
+    unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+    if (clusters)
+        clusters->clear();
+    if (triangleCount == 0)
+        return;
+
+    TriangleAdjacency adjacency(indices, vertexCount);
+    std::vector<unsigned int> live(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v)
+        live[v] = adjacency.count(v);
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    unsigned int timestamp = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = -1;
+    // the first fanning vertex starts the first cluster
+    for (unsigned int v = 0; v < vertexCount && fanning < 0; ++v)
+        if (live[v] > 0)
+            fanning = (int)v;
+    if (clusters)
+        clusters->push_back(0);
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; ++a)
+        {
+            unsigned int t = adjacency.triangles[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+        }
+
+        // best candidate: still in the cache after its remaining triangles are
+        // emitted; any live candidate (priority 0 included) beats a dead end
+        int next = -1;
+        int best = -1;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = (int)(timestamp - cacheTime[v]);
+            if (priority > best)
+            {
+                best = priority;
+                next = (int)v;
+            }
+        }
+        if (next < 0)
+        {
+            // dead end: go back through recently used vertices, then scan
+            while (!deadEnd.empty() && next < 0)
+            {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    next = (int)v;
+            }
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    next = (int)cursor;
+                cursor++;
+            }
+            if (next >= 0 && clusters)
+                clusters->push_back((unsigned int)(output.size() / 3));
+        }
+        fanning = next;
+    }
+    indices.swap(output);
+}
+
+// Reorder the clusters of a cache-optimized index list so that triangles
+// likely to occlude others are drawn first. Clusters are split further
+// wherever that costs less than threshold times the cluster's ACMR (1.05
+// allows 5% worse cache efficiency), then sorted by how far their average
+// normal points away from the mesh centre. positions point at the first
+// float3 position, stride is the vertex size in bytes.
+// ------------------------------------------------------------------------
+inline void OptimizeOverdraw(std::vector<uint32_t>& indices, const float* positions, unsigned int stride,
+    unsigned int vertexCount, float threshold = 1.05f, unsigned int cacheSize = 16)
+{
+    unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+    if (triangleCount == 0)
+        return;
+
+    std::vector<unsigned int> hardClusters;
+    OptimizeVertexCache(indices, vertexCount, cacheSize, &hardClusters);
+    hardClusters.push_back(triangleCount);
+
+    auto position = [positions, stride](uint32_t v) -> const float*
+    {
+        return (const float*)((const char*)positions + (size_t)v * stride);
+    };
+
+    // soft boundaries: cut wherever the running ACMR from the last cut is
+    // already within threshold of the whole hard cluster's ACMR
+    std::vector<unsigned int> clusters;
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    auto simulate = [&](unsigned int t) -> unsigned int
+    {
+        unsigned int misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[t * 3 + k];
+            if (timestamp - cacheTime[v] > cacheSize)
+            {
+                cacheTime[v] = timestamp++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+    auto flush = [&]() { timestamp += cacheSize + 1; };
+
+    for (size_t h = 0; h + 1 < hardClusters.size(); ++h)
+    {
+        unsigned int start = hardClusters[h], end = hardClusters[h + 1];
+        flush();
+        unsigned int clusterMisses = 0;
+        for (unsigned int t = start; t < end; ++t)
+            clusterMisses += simulate(t);
+        float clusterAcmr = (float)clusterMisses / (end - start);
+
+        flush();
+        clusters.push_back(start);
+        unsigned int misses = 0, cut = start;
+        for (unsigned int t = start; t < end; ++t)
+        {
+            misses += simulate(t);
+            if (t + 1 < end && (float)misses / (t + 1 - cut) <= clusterAcmr * threshold)
+            {
+                clusters.push_back(t + 1);
+                cut = t + 1;
+                misses = 0;
+                flush();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // mesh centroid, area weighted
+    float centre[3] = { 0.0f, 0.0f, 0.0f };
+    float totalArea = 0.0f;
+    std::vector<float> normals(triangleCount * 3), centroids(triangleCount * 3), areas(triangleCount);
+    for (unsigned int t = 0; t < triangleCount; ++t)
+    {
+        const float* a = position(indices[t * 3]);
+        const float* b = position(indices[t * 3 + 1]);
+        const float* c = position(indices[t * 3 + 2]);
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        // cross product length is twice the area, the factor cancels out
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        areas[t] = area;
+        for (int k = 0; k < 3; ++k)
+        {
+            normals[t * 3 + k] = n[k];
+            centroids[t * 3 + k] = (a[k] + b[k] + c[k]) / 3.0f;
+            centre[k] += centroids[t * 3 + k] * area;
+        }
+        totalArea += area;
+    }
+    if (totalArea > 0.0f)
+        for (int k = 0; k < 3; ++k)
+            centre[k] /= totalArea;
+
+    struct Cluster { unsigned int start, end; float key; };
+    std::vector<Cluster> order;
+    for (size_t c = 0; c + 1 < clusters.size(); ++c)
+    {
+        float normal[3] = { 0.0f, 0.0f, 0.0f }, centroid[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (unsigned int t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                normal[k] += normals[t * 3 + k];
+                centroid[k] += centroids[t * 3 + k] * areas[t];
+            }
+            area += areas[t];
+        }
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0.0f;
+        if (length > 0.0f && area > 0.0f)
+            for (int k = 0; k < 3; ++k)
+                key += (centroid[k] / area - centre[k]) * normal[k] / length;
+        order.push_back({ clusters[c], clusters[c + 1], key });
+    }
+    // outward facing clusters first: they cover the ones behind them
+    std::stable_sort(order.begin(), order.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : order)
+        output.insert(output.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    indices.swap(output);
+}
+
+// Reorder vertices by first use so the vertex fetch walks memory forwards,
+// dropping vertices no triangle references. Returns the new vertex count.
+// ------------------------------------------------------------------------
+inline unsigned int OptimizeVertexFetch(std::vector<unsigned char>& vertices, unsigned int vertexSize, std::vector<uint32_t>& indices)
+{
+    const uint32_t UNUSED = 0xFFFFFFFFu;
+    unsigned int vertexCount = (unsigned int)(vertices.size() / vertexSize);
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    std::vector<unsigned char> output(vertices.size());
+    unsigned int next = 0;
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = next;
+            memcpy(&output[(size_t)next * vertexSize], &vertices[(size_t)index * vertexSize], vertexSize);
+            next++;
+        }
+        index = remap[index];
+    }
+    output.resize((size_t)next * vertexSize);
+    vertices.swap(output);
+    return next;
+}
+
+// All three passes over a float vertex array whose first three floats per
+// vertex are the position (MeshData's format)
+// ------------------------------------------------------------------------
+inline void OptimizeMesh(std::vector<float>& vertices, unsigned int floatsPerVertex, std::vector<uint32_t>& indices)
+{
+    unsigned int vertexSize = floatsPerVertex * sizeof(float);
+    unsigned int vertexCount = (unsigned int)(vertices.size() / floatsPerVertex);
+    OptimizeOverdraw(indices, vertices.data(), vertexSize, vertexCount);
+
+    std::vector<unsigned char> bytes(vertices.size() * sizeof(float));
+    memcpy(bytes.data(), vertices.data(), bytes.size());
+    OptimizeVertexFetch(bytes, vertexSize, indices);
+    vertices.resize(bytes.size() / sizeof(float));
+    memcpy(vertices.data(), bytes.data(), bytes.size());
+}
+#endif
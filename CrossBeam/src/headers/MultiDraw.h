@@ -0,0 +1,232 @@
+#ifndef MULTI_DRAW_H
+#define MULTI_DRAW_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "GeometryPool.h"
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+#include "GLStateCache.h"
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+// ------------------------------------------------------------------------
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must be tightly packed");
+
+// A multi-draw shares one VAO and one primitive mode, so draws are grouped by
+// arena and mode; the key orders groups by arena first. Modes are the GL
+// primitive enums, GL_POINTS (0) to GL_PATCHES.
+// ------------------------------------------------------------------------
+const unsigned int MULTI_DRAW_MODES = GL_PATCHES + 1;
+
+inline unsigned int MultiDrawGroupKey(const GeometryRange& range)
+{
+    return range.arena * MULTI_DRAW_MODES + range.primitive;
+}
+
+// Collects a pass worth of GeometryPool draws and submits them with one
+// glMultiDrawElementsIndirect per vertex format and primitive mode. Commands and per-draw
+// records (ObjectBlock, read in the shader as uDraws.draws[gl_DrawIDARB])
+// stream through fenced StreamBuffers; programs need the MULTI_DRAW variant.
+//
+//     batch.begin();
+//     batch.add(mesh, object);  // per visible object
+//     batch.submit();           // draws and forgets the queued draws
+//     batch.end();              // after the pass, fences the streams
+//
+// add()/submit() may repeat between begin() and end(), e.g. once per
+// material; maxDraws bounds the whole frame.
+// Needs GL 4.3-level multi-draw indirect and SSBOs plus
+// ARB_shader_draw_parameters; without them use submitPerDraw(), which issues
+// the same draws one by one through a UniformRing and the plain variant.
+// ------------------------------------------------------------------------
+class MultiDrawBatch
+{
+public:
+    struct Stats
+    {
+        unsigned int draws = 0;
+        unsigned int calls = 0;
+    };
+
+    MultiDrawBatch(GeometryPool& pool, unsigned int maxDraws)
+        : pool(pool), maxDraws(maxDraws),
+        commands(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)maxDraws * sizeof(DrawElementsIndirectCommand)),
+        storageAlignment(offsetAlignment()),
+        records(isSupported() ? GL_SHADER_STORAGE_BUFFER : GL_ARRAY_BUFFER,
+            (GLsizeiptr)maxDraws * sizeof(ObjectBlock) + groupSlack(maxDraws, storageAlignment), 3, storageAlignment)
+    {
+        draws.reserve(maxDraws);
+    }
+    // ------------------------------------------------------------------------
+    static bool isSupported()
+    {
+        bool multiDraw = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object);
+        return multiDraw && GLEW_ARB_shader_draw_parameters;
+    }
+    // ------------------------------------------------------------------------
+    void begin()
+    {
+        draws.clear();
+        frameDraws = 0;
+        commands.beginFrame();
+        records.beginFrame();
+        stats = Stats();
+    }
+    // queue a draw; the mesh's dequantization is filled in from the pool
+    // ------------------------------------------------------------------------
+    void add(GeometryHandle mesh, const ObjectBlock& object)
+    {
+        if (frameDraws >= maxDraws)
+        {
+            std::cout << "ERROR::MULTI_DRAW::BATCH_FULL, dropping draws past " << maxDraws << std::endl;
+            return;
+        }
+        const GeometryRange& range = pool.get(mesh);
+        Draw draw;
+        draw.mesh = mesh;
+        draw.group = MultiDrawGroupKey(range);
+        draw.object = object;
+        draw.object.positionScale = Vec4(range.quantization.scale, 0.0f);
+        draw.object.positionOffset = Vec4(range.quantization.offset, 0.0f);
+        draws.push_back(draw);
+        frameDraws++;
+    }
+    // one glMultiDrawElementsIndirect per arena and primitive mode with draws
+    // ------------------------------------------------------------------------
+    void submit()
+    {
+        GLStateCache& state = GLStateCache::instance();
+        std::vector<unsigned int> order = sortByGroup();
+        size_t start = 0;
+        while (start < order.size())
+        {
+            unsigned int group = draws[order[start]].group;
+            size_t end = start;
+            while (end < order.size() && draws[order[end]].group == group)
+                end++;
+            GLsizei count = (GLsizei)(end - start);
+
+            // both arrays are indexed by gl_DrawIDARB, which restarts at 0 every call
+            StreamBuffer::Allocation commandSpace = commands.reserve(count * sizeof(DrawElementsIndirectCommand), 4);
+            StreamBuffer::Allocation recordSpace = records.reserve(count * sizeof(ObjectBlock), storageAlignment);
+            DrawElementsIndirectCommand* command = (DrawElementsIndirectCommand*)commandSpace.data;
+            ObjectBlock* record = (ObjectBlock*)recordSpace.data;
+            for (size_t i = start; i < end && command && record; ++i)
+            {
+                const Draw& draw = draws[order[i]];
+                const GeometryRange& range = pool.get(draw.mesh);
+                command->count = range.indexCount;
+                command->instanceCount = 1;
+                command->firstIndex = range.firstIndex;
+                command->baseVertex = range.baseVertex;
+                command->baseInstance = 0;
+                memcpy(record, &draw.object, sizeof(ObjectBlock));
+                command++;
+                record++;
+            }
+            commands.commit(commandSpace);
+            records.commit(recordSpace);
+
+            pool.bind(group / MULTI_DRAW_MODES);
+            state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DRAWS, records.ID, recordSpace.offset, recordSpace.size);
+            state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.ID);
+            glMultiDrawElementsIndirect(group % MULTI_DRAW_MODES, pool.getIndexType(), (const void*)commandSpace.offset, count, 0);
+            stats.draws += (unsigned int)count;
+            stats.calls++;
+            start = end;
+        }
+        draws.clear();
+    }
+    // the same draws, one glDrawElementsBaseVertex each with the record bound
+    // as the object block; for drivers without multi-draw and for comparison
+    // ------------------------------------------------------------------------
+    void submitPerDraw(UniformRing& objectUniforms)
+    {
+        for (unsigned int index : sortByGroup())
+        {
+            const Draw& draw = draws[index];
+            objectUniforms.pushAndBind(draw.object);
+            pool.draw(draw.mesh);
+            stats.draws++;
+            stats.calls++;
+        }
+        draws.clear();
+    }
+    // fence this pass's streamed commands and records
+    // ------------------------------------------------------------------------
+    void end()
+    {
+        commands.endFrame();
+        records.endFrame();
+    }
+    // ------------------------------------------------------------------------
+    // draws added since begin(), submitted or not
+    unsigned int getDrawCount() const { return frameDraws; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    // room for the alignment padding in front of each group's records: a
+    // frame has at most one group per draw. Commands are 4-byte multiples
+    // and need none.
+    // ------------------------------------------------------------------------
+    static GLsizeiptr groupSlack(unsigned int maxDraws, GLsizeiptr alignment)
+    {
+        return (GLsizeiptr)maxDraws * (alignment - 1);
+    }
+
+    // ------------------------------------------------------------------------
+    static GLsizeiptr offsetAlignment()
+    {
+        int alignment = 256;
+        if (isSupported())
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return (GLsizeiptr)alignment;
+    }
+
+    // ranges are looked up at submit time, the pool may have compacted since add()
+    struct Draw
+    {
+        GeometryHandle mesh;
+        // MultiDrawGroupKey()
+        unsigned int group;
+        ObjectBlock object;
+    };
+
+    GeometryPool& pool;
+    unsigned int maxDraws;
+    StreamBuffer commands;
+    GLsizeiptr storageAlignment;
+    StreamBuffer records;
+    std::vector<Draw> draws;
+    unsigned int frameDraws = 0;
+    Stats stats;
+
+    // draw indices grouped by arena and mode, submission order kept within a group
+    std::vector<unsigned int> sortByGroup() const
+    {
+        std::vector<unsigned int> counts(pool.getArenaCount() * MULTI_DRAW_MODES + 1, 0);
+        for (const Draw& draw : draws)
+            counts[draw.group + 1]++;
+        for (size_t g = 1; g < counts.size(); ++g)
+            counts[g] += counts[g - 1];
+        std::vector<unsigned int> order(draws.size());
+        for (unsigned int i = 0; i < draws.size(); ++i)
+            order[counts[draws[i].group]++] = i;
+        return order;
+    }
+};
+#endif
@@ -0,0 +1,165 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "Math.h"
+#include "VertexLayout.h"
+
+// Procedural test geometry in the same vertex format as the triangle in
+// Application.cpp: float3 position followed by float3 color.
+// ------------------------------------------------------------------------
+struct MeshData
+{
+    static const unsigned int FLOATS_PER_VERTEX = 6;
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    unsigned int vertexCount() const { return (unsigned int)(vertices.size() / FLOATS_PER_VERTEX); }
+    unsigned int triangleCount() const { return (unsigned int)(indices.size() / 3); }
+
+    static VertexLayout layout()
+    {
+        VertexLayout layout;
+        layout.add(0, 3, GL_FLOAT).add(1, 3, GL_FLOAT);
+        return layout;
+    }
+    // ------------------------------------------------------------------------
+    void addVertex(float x, float y, float z, float r, float g, float b)
+    {
+        float v[FLOATS_PER_VERTEX] = { x, y, z, r, g, b };
+        vertices.insert(vertices.end(), v, v + FLOATS_PER_VERTEX);
+    }
+    // ------------------------------------------------------------------------
+    void addQuad(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+    {
+        uint32_t q[6] = { a, b, c, a, c, d };
+        indices.insert(indices.end(), q, q + 6);
+    }
+};
+
+// Flat grid of cells x cells quads in the XY plane, spanning [-1, 1]
+// ------------------------------------------------------------------------
+inline MeshData MakeGrid(unsigned int cells)
+{
+    MeshData mesh;
+    for (unsigned int y = 0; y <= cells; ++y)
+        for (unsigned int x = 0; x <= cells; ++x)
+        {
+            float u = (float)x / cells, v = (float)y / cells;
+            mesh.addVertex(u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f, u, v, 0.5f);
+        }
+    for (unsigned int y = 0; y < cells; ++y)
+        for (unsigned int x = 0; x < cells; ++x)
+        {
+            uint32_t i = y * (cells + 1) + x;
+            mesh.addQuad(i, i + 1, i + cells + 2, i + cells + 1);
+        }
+    return mesh;
+}
+
+// UV sphere of radius 1; the seam and pole vertices are duplicated like an
+// exported model would have them
+// ------------------------------------------------------------------------
+inline MeshData MakeSphere(unsigned int slices, unsigned int stacks)
+{
+    const float PI = 3.14159265358979f;
+    MeshData mesh;
+    for (unsigned int j = 0; j <= stacks; ++j)
+        for (unsigned int i = 0; i <= slices; ++i)
+        {
+            float theta = PI * j / stacks, phi = 2.0f * PI * i / slices;
+            float x = std::sin(theta) * std::cos(phi), y = std::cos(theta), z = std::sin(theta) * std::sin(phi);
+            mesh.addVertex(x, y, z, x * 0.5f + 0.5f, y * 0.5f + 0.5f, z * 0.5f + 0.5f);
+        }
+    for (unsigned int j = 0; j < stacks; ++j)
+        for (unsigned int i = 0; i < slices; ++i)
+        {
+            uint32_t a = j * (slices + 1) + i;
+            mesh.addQuad(a, a + slices + 1, a + slices + 2, a + 1);
+        }
+    return mesh;
+}
+
+// Torus around the Y axis
+// ------------------------------------------------------------------------
+inline MeshData MakeTorus(unsigned int rings, unsigned int sides, float radius = 1.0f, float tube = 0.35f)
+{
+    const float PI = 3.14159265358979f;
+    MeshData mesh;
+    for (unsigned int j = 0; j <= rings; ++j)
+        for (unsigned int i = 0; i <= sides; ++i)
+        {
+            float u = 2.0f * PI * j / rings, v = 2.0f * PI * i / sides;
+            float r = radius + tube * std::cos(v);
+            mesh.addVertex(r * std::cos(u), tube * std::sin(v), r * std::sin(u),
+                (float)j / rings, (float)i / sides, 0.5f);
+        }
+    for (unsigned int j = 0; j < rings; ++j)
+        for (unsigned int i = 0; i < sides; ++i)
+        {
+            uint32_t a = j * (sides + 1) + i;
+            mesh.addQuad(a, a + 1, a + sides + 2, a + sides + 1);
+        }
+    return mesh;
+}
+
+// Axis-aligned box, one color per corner
+// ------------------------------------------------------------------------
+inline MeshData MakeBox(const Vec3& halfExtent)
+{
+    MeshData mesh;
+    for (int i = 0; i < 8; ++i)
+    {
+        float x = (i & 1) ? 1.0f : -1.0f, y = (i & 2) ? 1.0f : -1.0f, z = (i & 4) ? 1.0f : -1.0f;
+        mesh.addVertex(x * halfExtent.x, y * halfExtent.y, z * halfExtent.z, x * 0.5f + 0.5f, y * 0.5f + 0.5f, z * 0.5f + 0.5f);
+    }
+    // counter-clockwise seen from outside
+    mesh.addQuad(0, 2, 3, 1);
+    mesh.addQuad(4, 5, 7, 6);
+    mesh.addQuad(0, 1, 5, 4);
+    mesh.addQuad(2, 6, 7, 3);
+    mesh.addQuad(0, 4, 6, 2);
+    mesh.addQuad(1, 3, 7, 5);
+    return mesh;
+}
+
+// Shuffle triangle order (and the vertex order with it) the way a careless
+// exporter might, with a fixed seed so runs are comparable
+// ------------------------------------------------------------------------
+inline void ScrambleMesh(MeshData& mesh, uint32_t seed = 12345)
+{
+    auto next = [&seed](uint32_t range) -> uint32_t
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % range;
+    };
+    unsigned int triangles = mesh.triangleCount();
+    for (unsigned int t = triangles; t > 1; --t)
+    {
+        unsigned int other = next(t);
+        for (int k = 0; k < 3; ++k)
+            std::swap(mesh.indices[(t - 1) * 3 + k], mesh.indices[other * 3 + k]);
+    }
+
+    unsigned int count = mesh.vertexCount();
+    std::vector<uint32_t> remap(count);
+    for (unsigned int i = 0; i < count; ++i)
+        remap[i] = i;
+    for (unsigned int i = count; i > 1; --i)
+        std::swap(remap[i - 1], remap[next(i)]);
+    std::vector<float> vertices(mesh.vertices.size());
+    for (unsigned int i = 0; i < count; ++i)
+        for (unsigned int k = 0; k < MeshData::FLOATS_PER_VERTEX; ++k)
+            vertices[remap[i] * MeshData::FLOATS_PER_VERTEX + k] = mesh.vertices[i * MeshData::FLOATS_PER_VERTEX + k];
+    mesh.vertices.swap(vertices);
+    for (uint32_t& index : mesh.indices)
+        index = remap[index];
+}
+#endif
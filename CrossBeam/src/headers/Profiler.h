@@ -0,0 +1,420 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Scoped CPU profiler. Zones are RAII objects that stamp the time on entry
+// and exit and push one event into a ring buffer owned by their thread; no
+// locks, no allocation. Once per frame PROFILE_FRAME() drains every thread's
+// buffer into per-zone totals and, while capturing, into a trace that
+// writes as Chrome about:tracing / Perfetto JSON.
+//
+//     void Update()
+//     {
+//         PROFILE_SCOPE("Update");
+//         { PROFILE_SCOPE("Culling"); ... }   // nests under Update
+//     }
+//     PROFILE_FRAME();
+//
+// GpuProfiler feeds GPU pass times into the same frames and trace on a
+// timeline of its own. CROSSBEAM_SHIPPING (defined by the Release
+// configurations) compiles every macro and this header's classes out.
+// ------------------------------------------------------------------------
+#ifndef CROSSBEAM_SHIPPING
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CROSSBEAM_PROFILE_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CROSSBEAM_PROFILE_RDTSC 1
+#endif
+
+// Profiler clock: the time-stamp counter where there is one (a few ns to
+// read), steady_clock nanoseconds elsewhere. Profiler converts to time.
+// ------------------------------------------------------------------------
+inline uint64_t ProfileTimestamp()
+{
+#ifdef CROSSBEAM_PROFILE_RDTSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct ProfileEvent
+{
+    // string literal, compared by address
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+    uint32_t depth;
+};
+
+// Single-producer single-consumer ring of one thread's finished zones. The
+// thread pushes, PROFILE_FRAME() drains; events that do not fit until the
+// next drain are dropped and counted.
+// ------------------------------------------------------------------------
+class ProfileBuffer
+{
+public:
+    static const uint32_t CAPACITY = 1u << 15;
+
+    ProfileBuffer(uint32_t threadId, const std::string& name, bool gpu) : events(CAPACITY), threadId(threadId),
+        name(name), gpu(gpu)
+    {
+    }
+
+    // owning thread only
+    // ------------------------------------------------------------------------
+    void push(const char* name, uint64_t begin, uint64_t end, uint32_t depth)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail >= CAPACITY)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail >= CAPACITY)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        ProfileEvent& event = events[h & (CAPACITY - 1)];
+        event.name = name;
+        event.begin = begin;
+        event.end = end;
+        event.depth = depth;
+        head.store(h + 1, std::memory_order_release);
+    }
+    // one consumer at a time (the Profiler holds its lock)
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    void drain(Function function)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (; t < h; ++t)
+            function(events[t & (CAPACITY - 1)]);
+        tail.store(h, std::memory_order_release);
+    }
+    // ------------------------------------------------------------------------
+    uint32_t getThreadId() const { return threadId; }
+    const std::string& getName() const { return name; }
+    bool isGpu() const { return gpu; }
+    uint64_t takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+    // zone nesting depth of the owning thread
+    uint32_t depth = 0;
+
+private:
+    std::vector<ProfileEvent> events;
+    uint32_t threadId;
+    std::string name;
+    bool gpu;
+    // producer and consumer indices on their own cache lines
+    alignas(64) std::atomic<uint64_t> head{ 0 };
+    uint64_t cachedTail = 0;
+    alignas(64) std::atomic<uint64_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+// Owns the thread buffers, the per-zone frame totals and the trace capture.
+// ------------------------------------------------------------------------
+class Profiler
+{
+public:
+    struct ZoneStats
+    {
+        const char* name = nullptr;
+        // milliseconds summed over the zone's calls in the last frame
+        double lastFrameMs = 0.0;
+        // per frame, over every frame since start or reset()
+        double averageMs = 0.0;
+        double callsPerFrame = 0.0;
+        // measured on the GPU timeline
+        bool gpu = false;
+    };
+
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+    // the calling thread's buffer, registered on first use
+    // ------------------------------------------------------------------------
+    static ProfileBuffer& threadBuffer()
+    {
+        static thread_local ProfileBuffer* buffer = nullptr;
+        if (!buffer)
+            buffer = instance().registerBuffer("", false);
+        return *buffer;
+    }
+    // a trace row for events stamped elsewhere (GPU timestamps converted to
+    // profiler ticks); push to it from one thread only. Its zones are kept
+    // apart from the CPU zones of the same name
+    // ------------------------------------------------------------------------
+    ProfileBuffer& registerGpuTimeline(const std::string& name)
+    {
+        return *registerBuffer(name, true);
+    }
+    // drain every thread's events into the zone totals (and the capture),
+    // then close the frame
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // runs of the same zone are common, skip the lookup for them
+        const char* lastName = nullptr;
+        Zone* lastZone = nullptr;
+        for (std::unique_ptr<ProfileBuffer>& buffer : buffers)
+        {
+            uint32_t threadId = buffer->getThreadId();
+            std::unordered_map<const char*, Zone>& bufferZones = buffer->isGpu() ? gpuZones : zones;
+            lastName = nullptr;
+            buffer->drain([&, threadId](const ProfileEvent& event)
+            {
+                if (event.name != lastName)
+                {
+                    lastName = event.name;
+                    lastZone = &bufferZones[event.name];
+                }
+                Zone& zone = *lastZone;
+                zone.frameTicks += event.end - event.begin;
+                zone.frameCalls++;
+                if (capturing && capture.size() < MAX_CAPTURED_EVENTS)
+                    capture.push_back(CapturedEvent{ event, threadId });
+                else if (capturing)
+                    captureOverflow = true;
+            });
+            droppedEvents += buffer->takeDropped();
+        }
+        double msPerTick = 1.0 / (ticksPerMicrosecond() * 1000.0);
+        for (std::unordered_map<const char*, Zone>* map : { &zones, &gpuZones })
+        {
+            for (auto& entry : *map)
+            {
+                Zone& zone = entry.second;
+                zone.lastFrameMs = zone.frameTicks * msPerTick;
+                zone.totalMs += zone.lastFrameMs;
+                zone.totalCalls += zone.frameCalls;
+                zone.frameTicks = 0;
+                zone.frameCalls = 0;
+            }
+        }
+        frameCount++;
+    }
+    // zones by average time per frame, most expensive first
+    // ------------------------------------------------------------------------
+    std::vector<ZoneStats> getZoneStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ZoneStats> result;
+        for (std::unordered_map<const char*, Zone>* map : { &zones, &gpuZones })
+        {
+            for (auto& entry : *map)
+            {
+                ZoneStats stats;
+                stats.name = entry.first;
+                stats.lastFrameMs = entry.second.lastFrameMs;
+                stats.averageMs = frameCount ? entry.second.totalMs / frameCount : 0.0;
+                stats.callsPerFrame = frameCount ? (double)entry.second.totalCalls / frameCount : 0.0;
+                stats.gpu = map == &gpuZones;
+                result.push_back(stats);
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.averageMs > b.averageMs; });
+        return result;
+    }
+    // ------------------------------------------------------------------------
+    void printSummary()
+    {
+        std::vector<ZoneStats> stats = getZoneStats();
+        std::cout << "Profiler: " << frameCount << " frames, " << stats.size() << " zones";
+        if (droppedEvents)
+            std::cout << ", " << droppedEvents << " events dropped (drain more often)";
+        std::cout << std::endl;
+        for (const ZoneStats& zone : stats)
+        {
+            char line[160];
+            snprintf(line, sizeof(line), "  %-4s%-24s %9.4f ms avg %9.4f ms last %8.1f calls/frame", zone.gpu ? "GPU" : "",
+                zone.name, zone.averageMs, zone.lastFrameMs, zone.callsPerFrame);
+            std::cout << line << std::endl;
+        }
+    }
+    // forget the totals (not the capture)
+    // ------------------------------------------------------------------------
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        zones.clear();
+        gpuZones.clear();
+        frameCount = 0;
+        droppedEvents = 0;
+    }
+    // keep every drained event until writeTrace()
+    // ------------------------------------------------------------------------
+    void beginCapture()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        capture.clear();
+        captureOverflow = false;
+        capturing = true;
+    }
+    // write the capture as Chrome trace JSON and stop capturing; open it in
+    // about:tracing or ui.perfetto.dev
+    // ------------------------------------------------------------------------
+    bool writeTrace(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        capturing = false;
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        double ticksPerUs = ticksPerMicrosecond();
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const std::unique_ptr<ProfileBuffer>& buffer : buffers)
+        {
+            std::string name = buffer->getName().empty() ? "Thread " + std::to_string(buffer->getThreadId()) : buffer->getName();
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffer->getThreadId(), escape(name.c_str()).c_str());
+            first = false;
+        }
+        for (const CapturedEvent& captured : capture)
+        {
+            // converted GPU events can start before the profiler did
+            const ProfileEvent& event = captured.event;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                escape(event.name).c_str(), captured.threadId, (double)(int64_t)(event.begin - startTicks) / ticksPerUs,
+                (double)(event.end - event.begin) / ticksPerUs);
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        std::cout << "Profiler: " << capture.size() << " events written to " << path;
+        if (captureOverflow)
+            std::cout << " (capture full, later events were left out)";
+        std::cout << std::endl;
+        capture.clear();
+        return true;
+    }
+    // ------------------------------------------------------------------------
+    unsigned long long getFrameCount() const { return frameCount; }
+    // timestamp rate measured against steady_clock since startup; gets more
+    // precise the longer the program runs
+    // ------------------------------------------------------------------------
+    double ticksPerMicrosecond() const
+    {
+        double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+        uint64_t ticks = ProfileTimestamp() - startTicks;
+        return elapsedUs > 0.0 && ticks > 0 ? ticks / elapsedUs : 1000.0;
+    }
+
+private:
+    static const size_t MAX_CAPTURED_EVENTS = 4u << 20;
+
+    struct Zone
+    {
+        uint64_t frameTicks = 0;
+        uint64_t frameCalls = 0;
+        double lastFrameMs = 0.0;
+        double totalMs = 0.0;
+        uint64_t totalCalls = 0;
+    };
+    struct CapturedEvent
+    {
+        ProfileEvent event;
+        uint32_t threadId;
+    };
+
+    std::mutex mutex;
+    // buffers outlive their threads, a thread can exit with events queued
+    std::vector<std::unique_ptr<ProfileBuffer>> buffers;
+    std::unordered_map<const char*, Zone> zones;
+    std::unordered_map<const char*, Zone> gpuZones;
+    std::vector<CapturedEvent> capture;
+    bool capturing = false;
+    bool captureOverflow = false;
+    unsigned long long frameCount = 0;
+    unsigned long long droppedEvents = 0;
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point startTime;
+
+    Profiler() : startTicks(ProfileTimestamp()), startTime(std::chrono::steady_clock::now()) {}
+
+    // ------------------------------------------------------------------------
+    ProfileBuffer* registerBuffer(const std::string& name, bool gpu)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.emplace_back(new ProfileBuffer((uint32_t)buffers.size(), name, gpu));
+        return buffers.back().get();
+    }
+    // ------------------------------------------------------------------------
+    static std::string escape(const char* text)
+    {
+        std::string result;
+        for (; *text; ++text)
+        {
+            if (*text == '"' || *text == '\\')
+                result += '\\';
+            result += *text;
+        }
+        return result;
+    }
+};
+
+// RAII zone; use PROFILE_SCOPE so it compiles out with the rest
+// ------------------------------------------------------------------------
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* name) : name(name), buffer(Profiler::threadBuffer()), depth(buffer.depth++),
+        begin(ProfileTimestamp())
+    {
+    }
+    ~ProfileZone()
+    {
+        uint64_t end = ProfileTimestamp();
+        buffer.depth--;
+        buffer.push(name, begin, end, depth);
+    }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    ProfileBuffer& buffer;
+    uint32_t depth;
+    uint64_t begin;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::instance().endFrame()
+#define PROFILE_BEGIN_CAPTURE() Profiler::instance().beginCapture()
+#define PROFILE_WRITE_TRACE(path) Profiler::instance().writeTrace(path)
+#define PROFILE_PRINT_SUMMARY() Profiler::instance().printSummary()
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_BEGIN_CAPTURE() ((void)0)
+#define PROFILE_WRITE_TRACE(path) ((void)0)
+#define PROFILE_PRINT_SUMMARY() ((void)0)
+
+#endif
+#endif
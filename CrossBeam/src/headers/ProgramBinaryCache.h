@@ -0,0 +1,190 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <system_error>
+
+#include "Hash.h"
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary).
+// Programs are keyed by a hash of their sources, defines and the driver
+// vendor/renderer/version strings, so a driver update invalidates the cache.
+class ProgramBinaryCache
+{
+public:
+    // startup numbers, printed by the application once shaders are built
+    struct Stats
+    {
+        int programs = 0;
+        int hits = 0;
+        int misses = 0;
+        double totalMs = 0.0;
+    };
+
+    static ProgramBinaryCache& instance()
+    {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+    // ------------------------------------------------------------------------
+    void setDirectory(const std::string& path) { directory = path; }
+    const std::string& getDirectory() const { return directory; }
+    Stats& stats() { return buildStats; }
+    // needs a current context; the result is cached after the first call
+    // ------------------------------------------------------------------------
+    bool enabled()
+    {
+        if (supported < 0)
+        {
+            int formats = 0;
+            if (GLEW_ARB_get_program_binary || GLEW_VERSION_4_1)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            supported = formats > 0 ? 1 : 0;
+            if (supported)
+                driverHash = driverKey();
+        }
+        return supported == 1;
+    }
+    // the stage hashes already cover file contents and defines
+    // ------------------------------------------------------------------------
+    uint64_t makeKey(uint64_t vertexHash, uint64_t fragmentHash)
+    {
+        enabled();
+        uint64_t hash = HashBytes(&vertexHash, sizeof(vertexHash), driverHash);
+        return HashBytes(&fragmentHash, sizeof(fragmentHash), hash);
+    }
+    // try to fill program from the cache; the program must be freshly created.
+    // A stale or rejected binary is deleted so the next run stores a new one.
+    // ------------------------------------------------------------------------
+    bool load(unsigned int program, uint64_t key)
+    {
+        if (!enabled())
+            return false;
+        std::string path = pathFor(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        Header header;
+        std::vector<char> binary;
+        if (file.read((char*)&header, sizeof(header)) && header.magic == MAGIC && header.key == key)
+        {
+            binary.resize(header.length);
+            file.read(binary.data(), binary.size());
+        }
+        file.close();
+        if (binary.empty() || binary.size() != header.length)
+        {
+            remove(key);
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            remove(key);
+            return false;
+        }
+        return true;
+    }
+    // write a linked program's binary; it must have been linked with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    // ------------------------------------------------------------------------
+    void store(unsigned int program, uint64_t key)
+    {
+        if (!enabled())
+            return;
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        Header header;
+        header.key = key;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format, binary.data());
+        header.length = (uint32_t)written;
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        // write to a temporary first so a crash never leaves a truncated entry
+        std::string path = pathFor(key);
+        std::string tempPath = path + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR::PROGRAM_BINARY_CACHE::CANNOT_WRITE " << tempPath << std::endl;
+            return;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), written);
+        file.close();
+        std::filesystem::rename(tempPath, path, error);
+        if (error)
+            std::filesystem::remove(tempPath, error);
+    }
+    // ------------------------------------------------------------------------
+    void remove(uint64_t key)
+    {
+        std::error_code error;
+        std::filesystem::remove(pathFor(key), error);
+    }
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+private:
+    static const uint32_t MAGIC = 0x42504243; // "CBPB"
+
+    struct Header
+    {
+        uint32_t magic = MAGIC;
+        GLenum format = 0;
+        uint32_t length = 0;
+        uint32_t reserved = 0;
+        uint64_t key = 0;
+    };
+
+    std::string directory = "shadercache";
+    int supported = -1;
+    uint64_t driverHash = FNV_OFFSET_BASIS;
+    Stats buildStats;
+
+    ProgramBinaryCache() {}
+
+    // ------------------------------------------------------------------------
+    static uint64_t driverKey()
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (GLenum name : strings)
+        {
+            const char* value = (const char*)glGetString(name);
+            hash = HashString(value ? value : "", hash);
+            hash = HashBytes("|", 1, hash);
+        }
+        return hash;
+    }
+    // ------------------------------------------------------------------------
+    std::string pathFor(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+};
+#endif
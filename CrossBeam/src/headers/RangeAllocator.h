@@ -0,0 +1,135 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+// Offset allocator for sub-ranges of a larger resource (buffer elements,
+// bytes, ...). Only bookkeeping, it never touches memory. Free ranges are
+// indexed by size for best-fit allocation in O(log n) and by offset so that
+// neighbours coalesce on free().
+// ------------------------------------------------------------------------
+class RangeAllocator
+{
+public:
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+
+    RangeAllocator(uint32_t capacity = 0)
+    {
+        reset(capacity);
+    }
+    // forget every allocation
+    // ------------------------------------------------------------------------
+    void reset(uint32_t newCapacity)
+    {
+        freeByOffset.clear();
+        freeBySize.clear();
+        used.clear();
+        capacity = newCapacity;
+        usedSize = 0;
+        if (capacity > 0)
+            insertFree(0, capacity);
+    }
+    // offset of a new range, or INVALID when no free range is large enough
+    // ------------------------------------------------------------------------
+    uint32_t allocate(uint32_t size)
+    {
+        if (size == 0)
+            return INVALID;
+        auto fit = freeBySize.lower_bound(size);
+        if (fit == freeBySize.end())
+            return INVALID;
+        uint32_t offset = fit->second, rangeSize = fit->first;
+        eraseFree(offset, rangeSize);
+        if (rangeSize > size)
+            insertFree(offset + size, rangeSize - size);
+        used[offset] = size;
+        usedSize += size;
+        return offset;
+    }
+    // ------------------------------------------------------------------------
+    void free(uint32_t offset)
+    {
+        auto found = used.find(offset);
+        if (found == used.end())
+            return;
+        uint32_t size = found->second;
+        used.erase(found);
+        usedSize -= size;
+
+        // merge with the free neighbours on both sides
+        auto next = freeByOffset.lower_bound(offset);
+        if (next != freeByOffset.end() && next->first == offset + size)
+        {
+            size += next->second;
+            eraseFree(next->first, next->second);
+        }
+        auto previous = freeByOffset.lower_bound(offset);
+        if (previous != freeByOffset.begin())
+        {
+            --previous;
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                size += previous->second;
+                eraseFree(previous->first, previous->second);
+            }
+        }
+        insertFree(offset, size);
+    }
+    // extend the managed range; the new space joins a free range at the end
+    // ------------------------------------------------------------------------
+    void grow(uint32_t newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        uint32_t offset = capacity, size = newCapacity - capacity;
+        capacity = newCapacity;
+        auto last = freeByOffset.lower_bound(offset);
+        if (last != freeByOffset.begin())
+        {
+            --last;
+            if (last->first + last->second == offset)
+            {
+                offset = last->first;
+                size += last->second;
+                eraseFree(last->first, last->second);
+            }
+        }
+        insertFree(offset, size);
+    }
+    // ------------------------------------------------------------------------
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getUsed() const { return usedSize; }
+    uint32_t getLargestFree() const { return freeBySize.empty() ? 0 : freeBySize.rbegin()->first; }
+    size_t getFreeRangeCount() const { return freeByOffset.size(); }
+    // live allocations, offset -> size, in offset order
+    const std::map<uint32_t, uint32_t>& getAllocations() const { return used; }
+
+private:
+    std::map<uint32_t, uint32_t> freeByOffset;
+    std::multimap<uint32_t, uint32_t> freeBySize;
+    std::map<uint32_t, uint32_t> used;
+    uint32_t capacity = 0;
+    uint32_t usedSize = 0;
+
+    void insertFree(uint32_t offset, uint32_t size)
+    {
+        freeByOffset[offset] = size;
+        freeBySize.insert(std::make_pair(size, offset));
+    }
+    // ------------------------------------------------------------------------
+    void eraseFree(uint32_t offset, uint32_t size)
+    {
+        freeByOffset.erase(offset);
+        auto range = freeBySize.equal_range(size);
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second == offset)
+            {
+                freeBySize.erase(it);
+                break;
+            }
+    }
+};
+#endif
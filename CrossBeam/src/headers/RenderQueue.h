@@ -0,0 +1,298 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <iostream>
+#include <functional>
+#include <unordered_map>
+
+#include "Math.h"
+#include "BasicShader.h"
+#include "GeometryPool.h"
+#include "MultiDraw.h"
+#include "UniformBuffer.h"
+#include "CommandList.h"
+
+// Passes replay in this order; up to 16
+// ------------------------------------------------------------------------
+enum RenderPass
+{
+    RENDER_PASS_MAIN = 0,
+    RENDER_PASS_OVERLAY = 1,
+};
+
+// key + payload pair sorted by RadixSort
+// ------------------------------------------------------------------------
+struct SortItem
+{
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort on the 64-bit keys, one byte per pass. Passes whose
+// byte is the same in every key are skipped, so keys that only differ in a
+// few fields cost a few passes. scratch is resized as needed.
+// ------------------------------------------------------------------------
+inline void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+{
+    const size_t count = items.size();
+    if (count < 2)
+        return;
+    scratch.resize(count);
+    // all eight histograms in one read of the keys
+    uint32_t histograms[8][256] = {};
+    for (const SortItem& item : items)
+        for (int digit = 0; digit < 8; ++digit)
+            histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+
+    SortItem* source = items.data();
+    SortItem* target = scratch.data();
+    for (int digit = 0; digit < 8; ++digit)
+    {
+        uint32_t* histogram = histograms[digit];
+        if (histogram[(source[0].key >> (digit * 8)) & 0xFF] == count)
+            continue;
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket)
+        {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+            target[histogram[(source[i].key >> (digit * 8)) & 0xFF]++] = source[i];
+        std::swap(source, target);
+    }
+    if (source != items.data())
+        memcpy(items.data(), source, count * sizeof(SortItem));
+}
+
+// 64-bit draw sort key, most significant field first:
+//
+//     opaque:      pass:4 | 0 | program:11 | material:16 | arena:8 | depth:24
+//     translucent: pass:4 | 1 | ~depth:24 | program:11 | material:16 | arena:8
+//
+// so opaque draws group by state and go front-to-back within a state, and
+// translucent ones come after them back-to-front. Depth is the top bits of
+// the view distance's float pattern, which orders like the float itself.
+// ------------------------------------------------------------------------
+struct RenderKey
+{
+    static const uint32_t MAX_PROGRAMS = 1u << 11;
+    static const uint32_t MAX_MATERIALS = 1u << 16;
+    static const uint32_t MAX_ARENAS = 1u << 8;
+
+    static uint64_t make(unsigned int pass, bool translucent, uint32_t program, uint32_t material, uint32_t arena, float viewDistance)
+    {
+        uint64_t depth = depthBits(viewDistance);
+        uint64_t state = ((uint64_t)(program & (MAX_PROGRAMS - 1)) << 24) | ((uint64_t)(material & (MAX_MATERIALS - 1)) << 8) | (arena & (MAX_ARENAS - 1));
+        uint64_t key = ((uint64_t)(pass & 0xF) << 60) | ((uint64_t)(translucent ? 1 : 0) << 59);
+        if (translucent)
+            return key | ((~depth & 0xFFFFFF) << 35) | state;
+        return key | (state << 24) | depth;
+    }
+    // ------------------------------------------------------------------------
+    static uint32_t depthBits(float viewDistance)
+    {
+        if (!(viewDistance > 0.0f))
+            return 0;
+        uint32_t bits;
+        memcpy(&bits, &viewDistance, sizeof(bits));
+        // positive floats never set the sign bit: 31 bits, keep the top 24
+        return bits >> 7;
+    }
+    // ------------------------------------------------------------------------
+    static unsigned int pass(uint64_t key) { return (unsigned int)(key >> 60); }
+    static bool translucent(uint64_t key) { return ((key >> 59) & 1) != 0; }
+    static uint64_t state(uint64_t key) { return translucent(key) ? key & 0x7FFFFFFFFull : (key >> 24) & 0x7FFFFFFFFull; }
+    static uint32_t program(uint64_t key) { return (uint32_t)(state(key) >> 24); }
+    static uint32_t material(uint64_t key) { return (uint32_t)(state(key) >> 8) & (MAX_MATERIALS - 1); }
+    static uint32_t arena(uint64_t key) { return (uint32_t)state(key) & (MAX_ARENAS - 1); }
+};
+
+// Records a frame's draws as sort keys plus a payload index instead of
+// issuing them in program order, then radix-sorts the keys and replays them
+// so programs, materials and VAOs only change when the key says so. Opaque
+// draws go front-to-back within a state; translucent draws are blended
+// back-to-front after them.
+//
+//     queue.begin();
+//     queue.add(RENDER_PASS_MAIN, shader, material, mesh, object, distance);
+//     queue.submit(objectUniforms, bindMaterial, multiDraw ? &batch : nullptr);
+//
+// submit() records into a CommandList and executes it right away; record()
+// leaves the executing to the caller (see CommandRecorder).
+//
+// With a MultiDrawBatch every run of draws with the same state becomes one
+// multi-draw (the programs must be MULTI_DRAW variants, the batch must be
+// between begin() and end()); otherwise each draw binds its record through
+// objectUniforms.
+// ------------------------------------------------------------------------
+class RenderQueue
+{
+public:
+    struct Stats
+    {
+        unsigned int draws = 0;
+        unsigned int runs = 0;
+        unsigned int programChanges = 0;
+        unsigned int materialChanges = 0;
+        unsigned int vertexArrayChanges = 0;
+    };
+
+    RenderQueue(GeometryPool& pool) : pool(pool) {}
+
+    // ------------------------------------------------------------------------
+    void begin()
+    {
+        items.clear();
+        draws.clear();
+        stats = Stats();
+    }
+    // record a draw; viewDistance orders it within its state (see viewDistance())
+    // ------------------------------------------------------------------------
+    void add(unsigned int pass, Shader& shader, unsigned int material, GeometryHandle mesh, const ObjectBlock& object,
+        float viewDistance, bool translucent = false)
+    {
+        const GeometryRange& range = pool.get(mesh);
+        uint32_t program = programIndex(shader);
+        if (program >= RenderKey::MAX_PROGRAMS || material >= RenderKey::MAX_MATERIALS || range.arena >= RenderKey::MAX_ARENAS)
+        {
+            std::cout << "ERROR::RENDER_QUEUE::KEY_OVERFLOW, dropping draw (program " << program << ", material "
+                << material << ", arena " << range.arena << ")" << std::endl;
+            return;
+        }
+        Draw draw;
+        draw.mesh = mesh;
+        draw.object = object;
+        draw.object.positionScale = Vec4(range.quantization.scale, 0.0f);
+        draw.object.positionOffset = Vec4(range.quantization.offset, 0.0f);
+        SortItem item;
+        item.key = RenderKey::make(pass, translucent, program, material, range.arena, viewDistance);
+        item.index = (uint32_t)draws.size();
+        items.push_back(item);
+        draws.push_back(draw);
+    }
+    // sort and replay every recorded draw
+    // ------------------------------------------------------------------------
+    void submit(UniformRing& objectUniforms, const std::function<void(unsigned int)>& bindMaterial = nullptr,
+        MultiDrawBatch* batch = nullptr)
+    {
+        commands.reset();
+        record(commands);
+        CommandContext context;
+        context.pool = &pool;
+        context.objectUniforms = &objectUniforms;
+        context.bindMaterial = bindMaterial;
+        context.batch = batch;
+        commands.execute(context);
+    }
+    // sort and append the draws to a command list instead; no GL calls, so a
+    // worker thread can record its own queue into its own list
+    // ------------------------------------------------------------------------
+    void record(CommandList& list)
+    {
+        RadixSort(items, scratch);
+        size_t start = 0;
+        uint32_t boundProgram = 0, boundMaterial = 0, boundArena = 0;
+        bool first = true, blending = false;
+        while (start < items.size())
+        {
+            // a run shares pass, translucency, program and material
+            uint64_t key = items[start].key;
+            uint32_t program = RenderKey::program(key), material = RenderKey::material(key);
+            size_t end = start + 1;
+            while (end < items.size() && runOf(items[end].key) == runOf(key))
+                end++;
+
+            if (RenderKey::translucent(key) != blending)
+            {
+                blending = RenderKey::translucent(key);
+                list.setBlending(blending);
+            }
+            if (first || program != boundProgram)
+            {
+                list.useProgram(*programs[program]);
+                stats.programChanges++;
+            }
+            if (first || material != boundMaterial)
+            {
+                list.bindMaterial(material);
+                stats.materialChanges++;
+            }
+            boundProgram = program;
+            boundMaterial = material;
+
+            for (size_t i = start; i < end; ++i)
+            {
+                uint32_t arena = RenderKey::arena(items[i].key);
+                if (first || arena != boundArena)
+                    stats.vertexArrayChanges++;
+                boundArena = arena;
+                first = false;
+
+                const Draw& draw = draws[items[i].index];
+                list.draw(draw.mesh, draw.object);
+            }
+            list.flush();
+            stats.draws += (unsigned int)(end - start);
+            stats.runs++;
+            start = end;
+        }
+        if (blending)
+            list.setBlending(false);
+    }
+    // distance along the view axis, the clip-space w of a perspective projection
+    // ------------------------------------------------------------------------
+    static float viewDistance(const Mat4& viewProjection, const Vec3& position)
+    {
+        return (viewProjection * Vec4(position.x, position.y, position.z, 1.0f)).w;
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getDrawCount() const { return (unsigned int)draws.size(); }
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Draw
+    {
+        GeometryHandle mesh;
+        ObjectBlock object;
+    };
+
+    GeometryPool& pool;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    std::vector<Draw> draws;
+    CommandList commands;
+    // programs get small, stable indices the first time they are queued
+    std::vector<Shader*> programs;
+    std::unordered_map<Shader*, uint32_t> programIndices;
+    Stats stats;
+
+    // ------------------------------------------------------------------------
+    uint32_t programIndex(Shader& shader)
+    {
+        auto found = programIndices.find(&shader);
+        if (found != programIndices.end())
+            return found->second;
+        uint32_t index = (uint32_t)programs.size();
+        programs.push_back(&shader);
+        programIndices[&shader] = index;
+        return index;
+    }
+    // the key bits a run must share: everything above the arena. Translucent
+    // runs also split at arena changes, a multi-draw groups its draws by
+    // arena and would break the back-to-front order.
+    // ------------------------------------------------------------------------
+    static uint64_t runOf(uint64_t key)
+    {
+        uint64_t state = RenderKey::state(key);
+        return (key & (0x1Full << 59)) | (RenderKey::translucent(key) ? state : state >> 8);
+    }
+};
+#endif
@@ -0,0 +1,76 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#include "Hash.h"
+
+// Offscreen framebuffer: RGBA8 color and 24-bit depth / 8-bit stencil
+// renderbuffers of a fixed size. Headless runs draw into one instead of a
+// window.
+//
+//     RenderTarget target(1280, 720);
+//     target.bind();          // also sets the viewport
+//     ... draw ...
+//     uint64_t check = target.checksum();
+// ------------------------------------------------------------------------
+class RenderTarget
+{
+public:
+    RenderTarget(unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &depthStencil);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (GLsizei)width, (GLsizei)height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, (GLsizei)width, (GLsizei)height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_TARGET::INCOMPLETE 0x" << std::hex << status << std::dec << " (" << width << "x" << height << ")" << std::endl;
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+    // ------------------------------------------------------------------------
+    ~RenderTarget()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depthStencil);
+    }
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+
+    // ------------------------------------------------------------------------
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, (GLsizei)width, (GLsizei)height);
+    }
+    // hash of the color buffer, to compare runs without saving images
+    // ------------------------------------------------------------------------
+    uint64_t checksum() const
+    {
+        std::vector<unsigned char> pixels((size_t)width * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return HashBytes(pixels.data(), pixels.size());
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getFramebuffer() const { return framebuffer; }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+
+private:
+    unsigned int width, height;
+    unsigned int framebuffer = 0, color = 0, depthStencil = 0;
+};
+#endif
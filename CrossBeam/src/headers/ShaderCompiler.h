@@ -0,0 +1,277 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <GL/glew.h>
+
+#include <set>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+#include "BasicShader.h"
+#include "ShaderSource.h"
+#include "ProgramBinaryCache.h"
+
+// Builds many programs at once without stalling the render loop. submit()
+// queues compile+link and returns a Shader that draws with a placeholder
+// program until poll() sees the real one finish. With
+// GL_KHR_parallel_shader_compile the driver compiles on its own threads and
+// poll() only checks GL_COMPLETION_STATUS_KHR; without it, poll() finishes a
+// few programs per frame so each stall stays bounded.
+class ShaderCompiler
+{
+public:
+    // number of programs finished per poll() when completion can't be queried
+    int syncBudget = 1;
+
+    // needs a current context
+    // ------------------------------------------------------------------------
+    ShaderCompiler()
+    {
+        // let the driver use as many compiler threads as it likes
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else if (GLEW_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+
+        placeholder.reset(new Shader(Shader::fromSource(PLACEHOLDER_VERTEX, PLACEHOLDER_FRAGMENT)));
+    }
+    // queue a program; the returned shader is owned by the compiler
+    // ------------------------------------------------------------------------
+    Shader& submit(const char* vertexPath, const char* fragmentPath, const std::string& defines = "")
+    {
+        Shader& shader = createPending();
+        // remember where it came from so reload() can find it again
+        SourceFiles files;
+        files.shader = &shader;
+        files.vertexPath = vertexPath;
+        files.fragmentPath = fragmentPath;
+        files.defines = defines;
+        sourceFiles.push_back(files);
+        queueFiles(sourceFiles.back());
+        return shader;
+    }
+    // the shader an earlier submit() built from these files and defines, or
+    // nullptr; reload() keeps it current, so it can be handed out again
+    // ------------------------------------------------------------------------
+    Shader* find(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) const
+    {
+        for (const SourceFiles& files : sourceFiles)
+        {
+            if (files.vertexPath == vertexPath && files.fragmentPath == fragmentPath && files.defines == defines)
+                return files.shader;
+        }
+        return nullptr;
+    }
+    // ------------------------------------------------------------------------
+    Shader& submitSource(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines = "")
+    {
+        Shader& shader = createPending();
+        queue(shader, ShaderSource::fromString(vertexCode, defines), ShaderSource::fromString(fragmentCode, defines));
+        return shader;
+    }
+    // recompile every shader built from one of the changed files, includes
+    // too. The new program replaces the old one in poll() only if it links, so
+    // a broken edit leaves the last good program running.
+    // ------------------------------------------------------------------------
+    void reload(const std::vector<std::string>& changedPaths)
+    {
+        if (changedPaths.empty())
+            return;
+        ShaderSourceLoader& loader = ShaderSourceLoader::instance();
+        for (const std::string& path : changedPaths)
+            loader.invalidate(path);
+        for (SourceFiles& files : sourceFiles)
+        {
+            bool affected = false;
+            for (const std::string& path : changedPaths)
+                affected = affected || files.dependencies.count(ShaderSourceLoader::normalize(path)) > 0;
+            if (!affected)
+                continue;
+            std::cout << "Reloading shader: " << files.vertexPath << " + " << files.fragmentPath << std::endl;
+            queueFiles(files);
+        }
+    }
+    // advance in-flight programs; call once per frame before drawing
+    // ------------------------------------------------------------------------
+    void poll()
+    {
+        int finished = 0;
+        for (size_t i = 0; i < pending.size();)
+        {
+            if (parallel)
+            {
+                int done = 0;
+                glGetProgramiv(pending[i].program, GL_COMPLETION_STATUS_KHR, &done);
+                if (!done)
+                {
+                    ++i;
+                    continue;
+                }
+            }
+            else if (finished >= syncBudget)
+                break;
+
+            finish(pending[i]);
+            ++finished;
+            pending[i] = pending.back();
+            pending.pop_back();
+        }
+        if (finished > 0 && pending.empty())
+            reportBatch();
+    }
+    // ------------------------------------------------------------------------
+    bool busy() const
+    {
+        return !pending.empty();
+    }
+    // ------------------------------------------------------------------------
+    unsigned int placeholderProgram() const
+    {
+        return placeholder->ID;
+    }
+
+private:
+    struct PendingProgram
+    {
+        Shader* shader;
+        unsigned int program;
+        unsigned int stages[2];
+        uint64_t key;
+    };
+
+    struct SourceFiles
+    {
+        Shader* shader;
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::string defines;
+        // every file either stage pulled in, from the last load
+        std::set<std::string> dependencies;
+    };
+
+    bool parallel = false;
+    std::unique_ptr<Shader> placeholder;
+    std::vector<SourceFiles> sourceFiles;
+    std::vector<std::unique_ptr<Shader>> shaders;
+    std::vector<PendingProgram> pending;
+
+    // numbers for the batch currently in flight
+    std::chrono::high_resolution_clock::time_point batchStart;
+    int batchHits = 0;
+    int batchMisses = 0;
+    int batchFailures = 0;
+
+    // flat magenta, matching the attribute locations of our vertex shaders
+    static constexpr const char* PLACEHOLDER_VERTEX =
+        "#version 400 core\n"
+        "layout(location = 0) in vec3 aPos;\n"
+        "void main() { gl_Position = vec4(aPos, 1.0); }\n";
+    static constexpr const char* PLACEHOLDER_FRAGMENT =
+        "#version 400 core\n"
+        "out vec4 FragColor;\n"
+        "void main() { FragColor = vec4(1.0, 0.0, 1.0, 1.0); }\n";
+
+    // ------------------------------------------------------------------------
+    Shader& createPending()
+    {
+        shaders.emplace_back(new Shader());
+        Shader& shader = *shaders.back();
+        shader.ID = placeholder->ID;
+        shader.ready = false;
+        return shader;
+    }
+    // ------------------------------------------------------------------------
+    void queueFiles(SourceFiles& files)
+    {
+        ShaderSourceLoader& loader = ShaderSourceLoader::instance();
+        ShaderSource vertexSource, fragmentSource;
+        bool loaded = loader.load(files.vertexPath, files.defines, vertexSource);
+        loaded = loader.load(files.fragmentPath, files.defines, fragmentSource) && loaded;
+        // keep watching a missing include so fixing it triggers a reload
+        files.dependencies.clear();
+        files.dependencies.insert(vertexSource.files.begin(), vertexSource.files.end());
+        files.dependencies.insert(fragmentSource.files.begin(), fragmentSource.files.end());
+        files.dependencies.insert(ShaderSourceLoader::normalize(files.vertexPath));
+        files.dependencies.insert(ShaderSourceLoader::normalize(files.fragmentPath));
+        if (loaded)
+            queue(*files.shader, vertexSource, fragmentSource);
+    }
+    // ------------------------------------------------------------------------
+    void queue(Shader& shader, const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+    {
+        if (pending.empty())
+        {
+            batchStart = std::chrono::high_resolution_clock::now();
+            batchHits = batchMisses = batchFailures = 0;
+        }
+        // a newer edit supersedes a build that is still in flight
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            if (pending[i].shader != &shader)
+                continue;
+            // no status query here, that would wait for the stale build
+            glDeleteShader(pending[i].stages[0]);
+            glDeleteShader(pending[i].stages[1]);
+            glDeleteProgram(pending[i].program);
+            pending[i] = pending.back();
+            pending.pop_back();
+            break;
+        }
+        ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+        PendingProgram entry;
+        entry.shader = &shader;
+        entry.key = cache.makeKey(vertexSource.hash, fragmentSource.hash);
+
+        // a cached binary needs no compile, hand it over right away
+        unsigned int program = glCreateProgram();
+        if (cache.load(program, entry.key))
+        {
+            shader.adoptProgram(program);
+            cache.stats().programs++;
+            cache.stats().hits++;
+            batchHits++;
+            if (pending.empty())
+                reportBatch();
+            return;
+        }
+        glDeleteProgram(program);
+
+        entry.program = Shader::startProgram(vertexSource, fragmentSource, entry.stages);
+        pending.push_back(entry);
+    }
+    // ------------------------------------------------------------------------
+    void finish(PendingProgram& entry)
+    {
+        ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+        if (Shader::finishProgram(entry.program, entry.stages))
+        {
+            cache.store(entry.program, entry.key);
+            entry.shader->adoptProgram(entry.program);
+            cache.stats().programs++;
+            cache.stats().misses++;
+            batchMisses++;
+        }
+        else
+        {
+            // the shader keeps whatever it was drawing with
+            glDeleteProgram(entry.program);
+            batchFailures++;
+        }
+    }
+    // ------------------------------------------------------------------------
+    void reportBatch()
+    {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - batchStart).count();
+        ProgramBinaryCache::instance().stats().totalMs += ms;
+        std::cout << "Shaders: " << batchHits + batchMisses << " program(s) ready in " << ms << " ms ("
+            << batchHits << " from cache, " << batchMisses << " compiled";
+        if (batchFailures > 0)
+            std::cout << ", " << batchFailures << " failed";
+        std::cout << ")" << (parallel ? "" : " [no parallel compile]") << std::endl;
+    }
+};
+#endif
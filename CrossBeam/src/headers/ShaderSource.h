@@ -0,0 +1,286 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <set>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
+
+#include "Hash.h"
+
+// Read a whole file into a string. Copied rather than mapped: a mapping
+// cached across loads faults (SIGBUS) once an editor truncates the file.
+// ------------------------------------------------------------------------
+inline bool ReadWholeFile(const std::string& path, std::string& out)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::streamoff size = file.tellg();
+    if (size < 0)
+        return false;
+    out.resize((size_t)size);
+    file.seekg(0);
+    return size == 0 || (bool)file.read(&out[0], size);
+}
+
+// A stage's source as a list of string pointers for glShaderSource. Text
+// points straight into the loader's copies of the files; only the defines
+// block and the #line directives around includes are owned here.
+// ------------------------------------------------------------------------
+struct ShaderSource
+{
+    std::vector<const char*> strings;
+    std::vector<int> lengths;
+    // every file that contributed, root first
+    std::vector<std::string> files;
+    // identifies the final text: file content hashes in order plus defines
+    uint64_t hash = FNV_OFFSET_BASIS;
+    bool valid = true;
+
+    ShaderSource() {}
+    ShaderSource(ShaderSource&&) = default;
+    ShaderSource& operator=(ShaderSource&&) = default;
+    ShaderSource(const ShaderSource&) = delete;
+    ShaderSource& operator=(const ShaderSource&) = delete;
+
+    // ------------------------------------------------------------------------
+    void push(const char* text, size_t length)
+    {
+        if (length == 0)
+            return;
+        strings.push_back(text);
+        lengths.push_back((int)length);
+    }
+    // ------------------------------------------------------------------------
+    void pushOwned(std::string text)
+    {
+        storage.push_back(std::move(text));
+        push(storage.back().data(), storage.back().size());
+    }
+    // owned text that has to start on a line of its own, like a directive
+    // ------------------------------------------------------------------------
+    void pushLine(std::string text)
+    {
+        if (!lengths.empty() && strings.back()[lengths.back() - 1] != '\n')
+            text.insert(text.begin(), '\n');
+        pushOwned(std::move(text));
+    }
+    // whether any piece mentions a word (pieces are whole lines)
+    // ------------------------------------------------------------------------
+    bool contains(const std::string& word) const
+    {
+        for (size_t i = 0; i < strings.size(); ++i)
+        {
+            if (std::string_view(strings[i], lengths[i]).find(word) != std::string_view::npos)
+                return true;
+        }
+        return false;
+    }
+    // wrap in-memory code; the string must outlive the ShaderSource
+    // ------------------------------------------------------------------------
+    static ShaderSource fromString(const std::string& code, const std::string& defines)
+    {
+        ShaderSource source;
+        size_t versionEnd = versionLineEnd(code.data(), code.size());
+        source.push(code.data(), versionEnd);
+        source.addDefines(defines, versionEnd > 0, 0);
+        source.push(code.data() + versionEnd, code.size() - versionEnd);
+        source.hash = HashBytes(code.data(), code.size(), source.hash);
+        return source;
+    }
+    // length of a leading "#version ..." line including its newline, or 0
+    // ------------------------------------------------------------------------
+    static size_t versionLineEnd(const char* text, size_t length)
+    {
+        if (length < 8 || strncmp(text, "#version", 8) != 0)
+            return 0;
+        const char* newline = (const char*)memchr(text, '\n', length);
+        return newline ? (size_t)(newline - text) + 1 : length;
+    }
+    // defines go right after #version; #line keeps error line numbers right
+    // ------------------------------------------------------------------------
+    void addDefines(const std::string& defines, bool afterVersion, int sourceIndex)
+    {
+        if (defines.empty())
+            return;
+        std::string block = defines;
+        if (block.back() != '\n')
+            block += '\n';
+        block += "#line " + std::to_string(afterVersion ? 2 : 1) + " " + std::to_string(sourceIndex) + "\n";
+        pushLine(block);
+        uint64_t length = defines.size();
+        hash = HashBytes(&length, sizeof(length), hash);
+        hash = HashBytes(defines.data(), defines.size(), hash);
+    }
+
+private:
+    std::deque<std::string> storage;
+};
+
+// Reads and parses each shader file once per process. #include "file" is
+// resolved relative to the including file, and a file is pasted at most once
+// per stage, so includes need no guards of their own.
+// ------------------------------------------------------------------------
+class ShaderSourceLoader
+{
+public:
+    static ShaderSourceLoader& instance()
+    {
+        static ShaderSourceLoader loader;
+        return loader;
+    }
+    // build the string list for one stage; false if a file is missing
+    // ------------------------------------------------------------------------
+    bool load(const std::string& path, const std::string& defines, ShaderSource& out)
+    {
+        out = ShaderSource();
+        const ParsedFile* root = file(normalize(path));
+        if (!root)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            out.valid = false;
+            return false;
+        }
+        std::set<const ParsedFile*> included{ root };
+        emit(*root, defines, out, included);
+        return out.valid;
+    }
+    // drop a file so the next load reads and parses it again (hot reload)
+    // ------------------------------------------------------------------------
+    void invalidate(const std::string& path)
+    {
+        files.erase(normalize(path));
+    }
+    // ------------------------------------------------------------------------
+    static std::string normalize(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+private:
+    struct Piece
+    {
+        const char* text;
+        size_t length;
+        // resolved include path, empty for plain text
+        std::string include;
+        // line number of the text that follows an include
+        int nextLine;
+    };
+    struct ParsedFile
+    {
+        std::string path;
+        // the file as read; pieces point into it
+        std::string text;
+        uint64_t hash;
+        size_t versionEnd;
+        std::vector<Piece> pieces;
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<ParsedFile>> files;
+
+    ShaderSourceLoader() {}
+
+    // ------------------------------------------------------------------------
+    const ParsedFile* file(const std::string& path)
+    {
+        auto found = files.find(path);
+        if (found != files.end())
+            return found->second.get();
+
+        std::unique_ptr<ParsedFile> parsed(new ParsedFile());
+        parsed->path = path;
+        if (!ReadWholeFile(path, parsed->text))
+            return nullptr;
+        const char* text = parsed->text.data();
+        size_t size = parsed->text.size();
+        parsed->hash = HashBytes(text, size);
+        parsed->versionEnd = ShaderSource::versionLineEnd(text, size);
+
+        std::string directory = std::filesystem::path(path).parent_path().generic_string();
+        size_t runStart = parsed->versionEnd;
+        size_t lineStart = parsed->versionEnd;
+        int line = parsed->versionEnd > 0 ? 2 : 1;
+        while (lineStart < size)
+        {
+            const char* newline = (const char*)memchr(text + lineStart, '\n', size - lineStart);
+            size_t lineEnd = newline ? (size_t)(newline - text) + 1 : size;
+            std::string include = includePath(text + lineStart, lineEnd - lineStart);
+            if (!include.empty())
+            {
+                parsed->pieces.push_back({ text + runStart, lineStart - runStart, "", 0 });
+                std::string resolved = directory.empty() ? include : directory + "/" + include;
+                parsed->pieces.push_back({ nullptr, 0, normalize(resolved), line + 1 });
+                runStart = lineEnd;
+            }
+            lineStart = lineEnd;
+            ++line;
+        }
+        parsed->pieces.push_back({ text + runStart, size - runStart, "", 0 });
+
+        const ParsedFile* result = parsed.get();
+        files[path] = std::move(parsed);
+        return result;
+    }
+    // the quoted name of an '#include "name"' line, or empty
+    // ------------------------------------------------------------------------
+    static std::string includePath(const char* line, size_t length)
+    {
+        std::string_view view(line, length);
+        size_t start = view.find_first_not_of(" \t");
+        if (start == std::string_view::npos || view.compare(start, 8, "#include") != 0)
+            return std::string();
+        size_t open = view.find('"', start + 8);
+        size_t close = open == std::string_view::npos ? open : view.find('"', open + 1);
+        if (close == std::string_view::npos)
+            return std::string();
+        return std::string(view.substr(open + 1, close - open - 1));
+    }
+    // ------------------------------------------------------------------------
+    void emit(const ParsedFile& parsed, const std::string& defines, ShaderSource& out, std::set<const ParsedFile*>& included)
+    {
+        int index = (int)out.files.size();
+        out.files.push_back(parsed.path);
+        out.hash = HashBytes(&parsed.hash, sizeof(parsed.hash), out.hash);
+        if (index == 0)
+        {
+            out.push(parsed.text.data(), parsed.versionEnd);
+            out.addDefines(defines, parsed.versionEnd > 0, 0);
+        }
+        for (const Piece& piece : parsed.pieces)
+        {
+            if (piece.include.empty())
+            {
+                out.push(piece.text, piece.length);
+                continue;
+            }
+            const ParsedFile* child = file(piece.include);
+            if (!child)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << piece.include << " (from " << parsed.path << ")" << std::endl;
+                out.files.push_back(piece.include);
+                out.valid = false;
+                continue;
+            }
+            // already pasted: keep a blank line so the line numbers still match
+            if (!included.insert(child).second)
+            {
+                out.pushLine("\n");
+                continue;
+            }
+            out.pushLine("#line 1 " + std::to_string(out.files.size()) + "\n");
+            emit(*child, defines, out, included);
+            out.pushLine("#line " + std::to_string(piece.nextLine) + " " + std::to_string(index) + "\n");
+        }
+    }
+};
+#endif
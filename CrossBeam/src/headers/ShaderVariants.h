@@ -0,0 +1,188 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+#include "BasicShader.h"
+#include "ShaderSource.h"
+#include "ShaderCompiler.h"
+
+// Feature bits understood by the engine's shaders. Each one is injected as
+// "#define <NAME> 1" after the #version line, so the specialized program
+// only contains the branches it needs.
+const uint64_t SHADER_FEATURE_VERTEX_COLOR = 1ULL << 0;
+const uint64_t SHADER_FEATURE_SKINNING     = 1ULL << 1;
+const uint64_t SHADER_FEATURE_INSTANCING   = 1ULL << 2;
+const uint64_t SHADER_FEATURE_WIREFRAME    = 1ULL << 3;
+const uint64_t SHADER_FEATURE_VERTEX_NORMAL   = 1ULL << 4;
+const uint64_t SHADER_FEATURE_VERTEX_TANGENT  = 1ULL << 5;
+const uint64_t SHADER_FEATURE_VERTEX_TEXCOORD = 1ULL << 6;
+const uint64_t SHADER_FEATURE_MULTI_DRAW      = 1ULL << 7;
+
+// names in bit order; a ShaderVariants can be given its own list of up to 64
+inline const std::vector<std::string>& DefaultShaderFeatureNames()
+{
+    static const std::vector<std::string> names = { "VERTEX_COLOR", "SKINNING", "INSTANCING", "WIREFRAME",
+        "VERTEX_NORMAL", "VERTEX_TANGENT", "VERTEX_TEXCOORD", "MULTI_DRAW" };
+    return names;
+}
+
+// All permutations of one vertex/fragment pair, keyed by a feature bitmask.
+// Variants are compiled through the ShaderCompiler the first time get() asks
+// for them, or ahead of time with prewarm(). Bits for features the sources
+// never mention are dropped, and variants whose final sources hash the same
+// share one program. Both depend on the sources, so reload() works them out
+// again when one of the files changes.
+class ShaderVariants
+{
+public:
+    ShaderVariants(ShaderCompiler& compiler, const char* vertexPath, const char* fragmentPath,
+        const std::vector<std::string>& featureNames = DefaultShaderFeatureNames())
+        : compiler(compiler), vertexPath(vertexPath), fragmentPath(fragmentPath), featureNames(featureNames)
+    {
+        scan();
+    }
+    // after ShaderCompiler::reload() with the same paths: if the sources or
+    // their includes changed, the used features and the merging may have
+    // too, so both are redone and variants are looked up afresh. Programs
+    // built before are reused where the defines still match.
+    // ------------------------------------------------------------------------
+    void reload(const std::vector<std::string>& changedPaths)
+    {
+        bool affected = false;
+        for (const std::string& path : changedPaths)
+            affected = affected || dependencies.count(ShaderSourceLoader::normalize(path)) > 0;
+        if (!affected)
+            return;
+        scan();
+        byMask.clear();
+        byHash.clear();
+    }
+    // the shader for a feature set, queued for compilation on first use
+    // ------------------------------------------------------------------------
+    Shader& get(uint64_t features)
+    {
+        auto found = byMask.find(features);
+        if (found != byMask.end())
+            return *found->second;
+
+        uint64_t effective = features & usedMask;
+        std::string defines = definesFor(effective);
+        // until the next reload(), (source hash, defines) identifies the program
+        uint64_t key = HashString(defines.c_str(), sourceHash);
+        Shader* shader;
+        auto shared = byHash.find(key);
+        if (shared != byHash.end())
+            shader = shared->second;
+        else
+        {
+            shader = compiler.find(vertexPath, fragmentPath, defines);
+            if (!shader)
+                shader = &compiler.submit(vertexPath.c_str(), fragmentPath.c_str(), defines);
+            byHash[key] = shader;
+        }
+        byMask[features] = shader;
+        return *shader;
+    }
+    // queue every variant listed in a manifest: one variant per line, feature
+    // names separated by spaces, '#' starts a comment
+    // ------------------------------------------------------------------------
+    void prewarm(const char* manifestPath)
+    {
+        std::ifstream manifest(manifestPath);
+        if (!manifest)
+        {
+            std::cout << "ERROR::SHADER_VARIANTS::MANIFEST_NOT_FOUND " << manifestPath << std::endl;
+            return;
+        }
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            get(maskFor(line));
+        }
+    }
+    // "VERTEX_COLOR WIREFRAME" -> bitmask
+    // ------------------------------------------------------------------------
+    uint64_t maskFor(const std::string& names) const
+    {
+        uint64_t mask = 0;
+        std::istringstream stream(names);
+        std::string name;
+        while (stream >> name)
+        {
+            size_t bit = 0;
+            while (bit < featureNames.size() && featureNames[bit] != name)
+                ++bit;
+            if (bit < featureNames.size())
+                mask |= 1ULL << bit;
+            else
+                std::cout << "ERROR::SHADER_VARIANTS::UNKNOWN_FEATURE " << name << std::endl;
+        }
+        return mask;
+    }
+    // ------------------------------------------------------------------------
+    std::string definesFor(uint64_t mask) const
+    {
+        std::string defines;
+        for (size_t bit = 0; bit < featureNames.size() && bit < 64; ++bit)
+        {
+            if (mask & (1ULL << bit))
+                defines += "#define " + featureNames[bit] + " 1\n";
+        }
+        return defines;
+    }
+    // number of distinct programs behind the requested variants
+    // ------------------------------------------------------------------------
+    size_t programCount() const
+    {
+        return byHash.size();
+    }
+
+private:
+    ShaderCompiler& compiler;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> featureNames;
+    uint64_t usedMask = 0;
+    uint64_t sourceHash = 0;
+    // every file either source pulled in
+    std::set<std::string> dependencies;
+    std::unordered_map<uint64_t, Shader*> byMask;
+    std::unordered_map<uint64_t, Shader*> byHash;
+
+    // which features the sources test, and their combined hash
+    // ------------------------------------------------------------------------
+    void scan()
+    {
+        // includes count too, a feature may only be tested in shared code
+        ShaderSourceLoader& loader = ShaderSourceLoader::instance();
+        ShaderSource vertexSource, fragmentSource;
+        loader.load(vertexPath, "", vertexSource);
+        loader.load(fragmentPath, "", fragmentSource);
+        usedMask = 0;
+        for (size_t bit = 0; bit < featureNames.size() && bit < 64; ++bit)
+        {
+            const std::string& name = featureNames[bit];
+            if (vertexSource.contains(name) || fragmentSource.contains(name))
+                usedMask |= 1ULL << bit;
+        }
+        sourceHash = HashBytes(&fragmentSource.hash, sizeof(fragmentSource.hash), vertexSource.hash);
+        // a missing include stays watched, fixing it changes the features
+        dependencies.clear();
+        dependencies.insert(vertexSource.files.begin(), vertexSource.files.end());
+        dependencies.insert(fragmentSource.files.begin(), fragmentSource.files.end());
+        dependencies.insert(ShaderSourceLoader::normalize(vertexPath));
+        dependencies.insert(ShaderSourceLoader::normalize(fragmentPath));
+    }
+};
+#endif
@@ -0,0 +1,161 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <set>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+// Watches a shader directory (and its subdirectories) on a background thread
+// and collects the paths of files that were written. On Linux this uses
+// inotify; elsewhere it compares modification times a few times a second.
+// The render loop drains the changes once per frame with takeChanges().
+class ShaderWatcher
+{
+public:
+    ShaderWatcher(const std::string& directory) : root(directory)
+    {
+        running = true;
+        worker = std::thread(&ShaderWatcher::run, this);
+    }
+    // ------------------------------------------------------------------------
+    ~ShaderWatcher()
+    {
+        running = false;
+        if (worker.joinable())
+            worker.join();
+    }
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // normalized paths written since the last call; cheap when nothing changed
+    // ------------------------------------------------------------------------
+    std::vector<std::string> takeChanges()
+    {
+        std::vector<std::string> result;
+        if (!hasChanges.load(std::memory_order_acquire))
+            return result;
+        std::lock_guard<std::mutex> lock(mutex);
+        result.assign(changed.begin(), changed.end());
+        changed.clear();
+        hasChanges.store(false, std::memory_order_release);
+        return result;
+    }
+    // ------------------------------------------------------------------------
+    static std::string normalize(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+private:
+    std::string root;
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> hasChanges{ false };
+    std::mutex mutex;
+    std::set<std::string> changed;
+
+    // ------------------------------------------------------------------------
+    void push(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.insert(normalize(path));
+        hasChanges.store(true, std::memory_order_release);
+    }
+    // ------------------------------------------------------------------------
+    std::vector<std::string> directories() const
+    {
+        std::vector<std::string> result{ root };
+        std::error_code error;
+        for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+        {
+            if (it->is_directory(error))
+                result.push_back(it->path().generic_string());
+        }
+        return result;
+    }
+
+#ifdef __linux__
+    // ------------------------------------------------------------------------
+    void run()
+    {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            return;
+        std::map<int, std::string> watches;
+        for (const std::string& directory : directories())
+        {
+            // editors either rewrite the file in place or rename a temp over it
+            int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd >= 0)
+                watches[wd] = directory;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        pollfd pfd = { fd, POLLIN, 0 };
+        while (running)
+        {
+            // wake up regularly so the destructor never waits long
+            if (::poll(&pfd, 1, 100) <= 0)
+                continue;
+            ssize_t length;
+            while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* p = buffer; p < buffer + length;)
+                {
+                    const inotify_event* event = (const inotify_event*)p;
+                    if (event->len > 0 && watches.count(event->wd))
+                        push(watches[event->wd] + "/" + event->name);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+        close(fd);
+    }
+#else
+    // ------------------------------------------------------------------------
+    void run()
+    {
+        std::map<std::string, std::filesystem::file_time_type> stamps;
+        bool first = true;
+        while (running)
+        {
+            std::error_code error;
+            for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+            {
+                if (!it->is_regular_file(error))
+                    continue;
+                std::string path = it->path().generic_string();
+                std::filesystem::file_time_type stamp = it->last_write_time(error);
+                auto found = stamps.find(path);
+                if (found == stamps.end())
+                {
+                    stamps[path] = stamp;
+                    if (!first)
+                        push(path);
+                }
+                else if (found->second != stamp)
+                {
+                    found->second = stamp;
+                    push(path);
+                }
+            }
+            first = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+    }
+#endif
+};
+#endif
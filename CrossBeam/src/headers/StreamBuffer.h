@@ -0,0 +1,231 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#include "GLStateCache.h"
+
+// Ring buffer for data written every frame (per-draw uniforms, dynamic
+// vertices, indirect commands). Storage is allocated once and split into one
+// region per frame in flight; each region is fenced when its frame ends and
+// only waited on when the ring comes back round to it, so with 3 regions the
+// CPU writes frame N+2 while the GPU still reads frame N.
+//
+// With GL_ARB_buffer_storage (GL 4.4) the buffer is mapped once, persistent
+// and coherent, and writes are plain memcpys. Otherwise every write maps its
+// range unsynchronized; the fences make that safe.
+//
+// A frame that outgrows its region gets a new, larger buffer instead of
+// rewinding over data its earlier draws still read; the old buffer lives on
+// in GL until those draws finish. Read ID when binding, it changes then, and
+// commit an allocation before reserving the next one.
+//
+//     stream.beginFrame();
+//     GLintptr offset = stream.write(&data, sizeof(data));
+//     ... draw using the range at offset ...
+//     stream.endFrame();
+// ------------------------------------------------------------------------
+class StreamBuffer
+{
+public:
+    struct Stats
+    {
+        unsigned long long waits = 0;
+        double waitMs = 0.0;
+        // regions outgrown, each one a new buffer
+        unsigned long long grows = 0;
+    };
+    // space handed out by reserve(); write into data, then commit()
+    struct Allocation
+    {
+        void* data = nullptr;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    unsigned int ID = 0;
+
+    // regionAlignment: the largest alignment reserve() will be asked for; the
+    // region size is rounded up to it so every region starts aligned
+    StreamBuffer(GLenum target, GLsizeiptr regionSize, unsigned int regions = 3, GLsizeiptr regionAlignment = 256)
+        : target(target), regionAlignment(std::max(regionAlignment, (GLsizeiptr)1)), regionCount(regions)
+    {
+        this->regionSize = alignUp(regionSize, this->regionAlignment);
+        allocate();
+    }
+    // ------------------------------------------------------------------------
+    ~StreamBuffer()
+    {
+        release();
+    }
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // move to the next region, waiting for the GPU if it still reads it
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        region = (region + 1) % regionCount;
+        head = 0;
+        GLsync& fence = fences[region];
+        if (!fence)
+            return;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            typedef std::chrono::high_resolution_clock Clock;
+            Clock::time_point start = Clock::now();
+            stats.waits++;
+            // flush once so the fence is guaranteed to signal, then wait in 1 ms steps
+            GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            do
+            {
+                status = glClientWaitSync(fence, flags, 1000000);
+                flags = 0;
+            } while (status == GL_TIMEOUT_EXPIRED);
+            stats.waitMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    // fence everything written this frame; call after its last draw
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        if (fences[region])
+            glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    // space for size bytes in the current region, at an offset that is a
+    // multiple of alignment (UBO ranges need GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+    // ------------------------------------------------------------------------
+    Allocation reserve(GLsizeiptr size, GLsizeiptr alignment = 4)
+    {
+        // aligned in the buffer, not just in the region
+        GLintptr base = (GLintptr)region * regionSize;
+        GLsizeiptr start = alignUp(base + head, alignment) - base;
+        if (start + size > regionSize)
+        {
+            grow(size);
+            base = 0;
+            start = 0;
+        }
+        head = start + size;
+
+        Allocation allocation;
+        allocation.offset = base + start;
+        allocation.size = size;
+        if (persistent)
+            allocation.data = mapped + allocation.offset;
+        else
+        {
+            GLStateCache::instance().bindBuffer(target, ID);
+            allocation.data = glMapBufferRange(target, allocation.offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        }
+        return allocation;
+    }
+    // coherent mappings need nothing; the fallback path unmaps the range
+    // ------------------------------------------------------------------------
+    void commit(const Allocation& allocation)
+    {
+        if (persistent || !allocation.data)
+            return;
+        GLStateCache::instance().bindBuffer(target, ID);
+        glUnmapBuffer(target);
+    }
+    // copy data in and return its offset in the buffer
+    // ------------------------------------------------------------------------
+    GLintptr write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 4)
+    {
+        Allocation allocation = reserve(size, alignment);
+        if (allocation.data)
+            memcpy(allocation.data, data, size);
+        commit(allocation);
+        return allocation.offset;
+    }
+    // ------------------------------------------------------------------------
+    bool isPersistent() const { return persistent; }
+    GLsizeiptr getRegionSize() const { return regionSize; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    GLenum target;
+    GLsizeiptr regionAlignment;
+    GLsizeiptr regionSize = 0;
+    unsigned int regionCount;
+    unsigned int region = 0;
+    GLsizeiptr head = 0;
+    bool persistent = false;
+    unsigned char* mapped = nullptr;
+    GLsync* fences = nullptr;
+    Stats stats;
+
+    // ------------------------------------------------------------------------
+    static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+    // storage for regionCount regions of regionSize, fences cleared
+    // ------------------------------------------------------------------------
+    void allocate()
+    {
+        GLsizeiptr totalSize = regionSize * regionCount;
+        glGenBuffers(1, &ID);
+        GLStateCache::instance().bindBuffer(target, ID);
+        persistent = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, totalSize, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(target, 0, totalSize, flags);
+            if (!mapped)
+            {
+                std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED, falling back to mapping per write" << std::endl;
+                // immutable storage cannot be respecified, start over with a mutable buffer
+                GLStateCache::instance().forgetBuffer(ID);
+                glDeleteBuffers(1, &ID);
+                glGenBuffers(1, &ID);
+                GLStateCache::instance().bindBuffer(target, ID);
+                persistent = false;
+            }
+        }
+        if (!persistent)
+            glBufferData(target, totalSize, NULL, GL_STREAM_DRAW);
+        fences = new GLsync[regionCount]();
+    }
+    // GL keeps the buffer alive until draws already issued are done with it
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        for (unsigned int i = 0; i < regionCount; ++i)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        delete[] fences;
+        fences = nullptr;
+        // deleting the buffer also unmaps it
+        GLStateCache::instance().forgetBuffer(ID);
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+        mapped = nullptr;
+    }
+    // the current frame needs more than its region: move to a new buffer with
+    // regions at least twice as large, starting the frame over in region 0
+    // ------------------------------------------------------------------------
+    void grow(GLsizeiptr size)
+    {
+        release();
+        regionSize = alignUp(std::max(regionSize * 2, size), regionAlignment);
+        allocate();
+        region = 0;
+        head = 0;
+        stats.grows++;
+        std::cout << "StreamBuffer: region full, grown to " << regionSize << " bytes per region" << std::endl;
+    }
+};
+#endif
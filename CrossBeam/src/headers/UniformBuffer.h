@@ -0,0 +1,190 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "Math.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+
+// Fixed binding points shared by every program. Shader binds blocks with
+// these names when it reflects a program, so GLSL 4.0 shaders need no
+// layout(binding = N).
+// ------------------------------------------------------------------------
+enum UniformBinding
+{
+    UNIFORM_BINDING_FRAME = 0,
+    UNIFORM_BINDING_MATERIAL = 1,
+    UNIFORM_BINDING_OBJECT = 2,
+    UNIFORM_BINDING_CULL_VIEW = 3,
+};
+
+inline int UniformBlockBinding(const char* blockName)
+{
+    if (strcmp(blockName, "FrameBlock") == 0)
+        return UNIFORM_BINDING_FRAME;
+    if (strcmp(blockName, "MaterialBlock") == 0)
+        return UNIFORM_BINDING_MATERIAL;
+    if (strcmp(blockName, "ObjectBlock") == 0)
+        return UNIFORM_BINDING_OBJECT;
+    if (strcmp(blockName, "CullViewBlock") == 0)
+        return UNIFORM_BINDING_CULL_VIEW;
+    return -1;
+}
+
+// The same for shader storage blocks
+// ------------------------------------------------------------------------
+enum StorageBinding
+{
+    STORAGE_BINDING_DRAWS = 0,
+    // GPU culling inputs and outputs
+    STORAGE_BINDING_CULL_OBJECTS = 1,
+    STORAGE_BINDING_CULL_RECORDS = 2,
+    STORAGE_BINDING_CULL_COMMANDS = 3,
+    STORAGE_BINDING_CULL_VISIBLE_RECORDS = 4,
+    STORAGE_BINDING_CULL_COUNTERS = 5,
+    STORAGE_BINDING_CULL_VISIBILITY = 6,
+};
+
+inline int StorageBlockBinding(const char* blockName)
+{
+    if (strcmp(blockName, "DrawBlock") == 0)
+        return STORAGE_BINDING_DRAWS;
+    if (strcmp(blockName, "CullObjectBlock") == 0)
+        return STORAGE_BINDING_CULL_OBJECTS;
+    if (strcmp(blockName, "CullRecordBlock") == 0)
+        return STORAGE_BINDING_CULL_RECORDS;
+    if (strcmp(blockName, "CullCommandBlock") == 0)
+        return STORAGE_BINDING_CULL_COMMANDS;
+    if (strcmp(blockName, "CullVisibleRecordBlock") == 0)
+        return STORAGE_BINDING_CULL_VISIBLE_RECORDS;
+    if (strcmp(blockName, "CullCounterBlock") == 0)
+        return STORAGE_BINDING_CULL_COUNTERS;
+    if (strcmp(blockName, "CullVisibilityBlock") == 0)
+        return STORAGE_BINDING_CULL_VISIBILITY;
+    return -1;
+}
+
+// std140 mirrors of res/shaders/include/UniformBlocks.glsl. Only vec4 and
+// mat4 members, so the C++ layout matches without padding rules.
+// ------------------------------------------------------------------------
+struct FrameBlock
+{
+    Mat4 view;
+    Mat4 projection;
+    Mat4 viewProjection;
+    // x = seconds since start, y = frame delta, z = frame index
+    Vec4 time;
+};
+struct MaterialBlock
+{
+    Vec4 baseColor;
+    // free for material-specific values
+    Vec4 params;
+};
+struct ObjectBlock
+{
+    Mat4 model;
+    Vec4 color;
+    // dequantization of packed positions: position * scale + offset
+    Vec4 positionScale = Vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    Vec4 positionOffset = Vec4(0.0f, 0.0f, 0.0f, 0.0f);
+};
+static_assert(sizeof(FrameBlock) == 3 * 64 + 16, "FrameBlock must match std140");
+static_assert(sizeof(MaterialBlock) == 32, "MaterialBlock must match std140");
+static_assert(sizeof(ObjectBlock) == 112, "ObjectBlock must match std140");
+
+// One block's worth of data bound to a fixed binding point, for data that
+// rarely changes (materials); per-frame data goes through a UniformRing
+// ------------------------------------------------------------------------
+template <typename T>
+class UniformBuffer
+{
+public:
+    unsigned int ID = 0;
+
+    UniformBuffer(unsigned int binding) : binding(binding)
+    {
+        glGenBuffers(1, &ID);
+        GLStateCache::instance().bindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        bind();
+    }
+    // ------------------------------------------------------------------------
+    void update(const T& data)
+    {
+        GLStateCache::instance().bindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+    // only needed when several buffers share a binding point, e.g. materials
+    // ------------------------------------------------------------------------
+    void bind() const
+    {
+        GLStateCache::instance().bindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+private:
+    unsigned int binding;
+};
+
+// Per-draw blocks sub-allocated from a StreamBuffer. Each draw pushes its
+// block and binds that range with glBindBufferRange, so there is one write
+// and one bind per draw no matter how many values the block holds.
+// ------------------------------------------------------------------------
+class UniformRing
+{
+public:
+    UniformRing(unsigned int binding, unsigned int regionSize, unsigned int regions = 3)
+        : binding(binding), alignment(offsetAlignment()), stream(GL_UNIFORM_BUFFER, regionSize, regions, alignment)
+    {
+    }
+    // move to the next frame's region; call once per frame
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        stream.beginFrame();
+    }
+    // call after the frame's last draw that reads the ring
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        stream.endFrame();
+    }
+    // copy a block in and return its offset in the buffer
+    // ------------------------------------------------------------------------
+    unsigned int push(const void* data, unsigned int size)
+    {
+        return (unsigned int)stream.write(data, size, alignment);
+    }
+    // ------------------------------------------------------------------------
+    void bind(unsigned int offset, unsigned int size) const
+    {
+        GLStateCache::instance().bindBufferRange(GL_UNIFORM_BUFFER, binding, stream.ID, offset, size);
+    }
+    // ------------------------------------------------------------------------
+    template <typename T>
+    void pushAndBind(const T& block)
+    {
+        bind(push(&block, sizeof(T)), sizeof(T));
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getID() const { return stream.ID; }
+    const StreamBuffer& getStream() const { return stream; }
+
+private:
+    unsigned int binding;
+    unsigned int alignment;
+    StreamBuffer stream;
+
+    // ------------------------------------------------------------------------
+    static unsigned int offsetAlignment()
+    {
+        int alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return (unsigned int)alignment;
+    }
+};
+#endif
@@ -0,0 +1,114 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+// One vertex attribute: where it goes in the shader and how it is stored
+// ------------------------------------------------------------------------
+struct VertexAttribute
+{
+    unsigned int location;
+    int components;
+    GLenum type;
+    // fixed-point data is read as [0,1] / [-1,1] floats
+    bool normalized;
+    // read with glVertexAttribIPointer (ivec/uvec inputs)
+    bool integer;
+    unsigned int offset;
+};
+
+// Declarative interleaved vertex format. Attributes are packed in the order
+// they are added and the stride follows from their sizes:
+//
+//     VertexLayout layout;
+//     layout.add(0, 3, GL_FLOAT).add(1, 3, GL_FLOAT);
+// ------------------------------------------------------------------------
+class VertexLayout
+{
+public:
+    VertexLayout& add(unsigned int location, int components, GLenum type, bool normalized = false)
+    {
+        attributes.push_back({ location, components, type, normalized, false, stride });
+        stride += attributeSize(components, type);
+        return *this;
+    }
+    // ------------------------------------------------------------------------
+    VertexLayout& addInteger(unsigned int location, int components, GLenum type)
+    {
+        attributes.push_back({ location, components, type, false, true, stride });
+        stride += attributeSize(components, type);
+        return *this;
+    }
+    // skip bytes, e.g. to keep attributes 4-byte aligned
+    // ------------------------------------------------------------------------
+    VertexLayout& pad(unsigned int bytes)
+    {
+        stride += bytes;
+        return *this;
+    }
+    // set up the attribute pointers of the bound VAO for the bound GL_ARRAY_BUFFER
+    // ------------------------------------------------------------------------
+    void apply(size_t baseOffset = 0) const
+    {
+        for (const VertexAttribute& attribute : attributes)
+        {
+            const void* pointer = (const void*)(baseOffset + attribute.offset);
+            if (attribute.integer)
+                glVertexAttribIPointer(attribute.location, attribute.components, attribute.type, stride, pointer);
+            else
+                glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+                    attribute.normalized ? GL_TRUE : GL_FALSE, stride, pointer);
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+    // ------------------------------------------------------------------------
+    unsigned int getStride() const { return stride; }
+    const std::vector<VertexAttribute>& getAttributes() const { return attributes; }
+
+    // ------------------------------------------------------------------------
+    bool operator==(const VertexLayout& other) const
+    {
+        if (stride != other.stride || attributes.size() != other.attributes.size())
+            return false;
+        for (size_t i = 0; i < attributes.size(); ++i)
+        {
+            const VertexAttribute& a = attributes[i];
+            const VertexAttribute& b = other.attributes[i];
+            if (a.location != b.location || a.components != b.components || a.type != b.type ||
+                a.normalized != b.normalized || a.integer != b.integer || a.offset != b.offset)
+                return false;
+        }
+        return true;
+    }
+    bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+
+    // ------------------------------------------------------------------------
+    static unsigned int attributeSize(int components, GLenum type)
+    {
+        switch (type)
+        {
+        // packed: all four components share one 32-bit word
+        case GL_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+            return 4;
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return components;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2 * components;
+        case GL_DOUBLE:
+            return 8 * components;
+        default:
+            return 4 * components;
+        }
+    }
+
+private:
+    std::vector<VertexAttribute> attributes;
+    unsigned int stride = 0;
+};
+#endif
@@ -0,0 +1,282 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "Math.h"
+#include "VertexLayout.h"
+
+// Conversions to the compact attribute types the vertex fetch can decode for
+// free. Every packed attribute is declared normalized, so shaders read them
+// as plain floats.
+
+// IEEE 754 binary16, round to nearest even
+// ------------------------------------------------------------------------
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t floatExponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    int exponent = (int)floatExponent - 127 + 15;
+
+    if (floatExponent == 0xFFu)
+        return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7C00u);
+    if (exponent <= 0)
+    {
+        // subnormal half, or zero
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        unsigned int shift = (unsigned int)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1u), middle = 1u << (shift - 1u);
+        if (rest > middle || (rest == middle && (half & 1u)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFFu;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        half++;
+    return (uint16_t)half;
+}
+// ------------------------------------------------------------------------
+inline float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+    if (exponent == 0x1Fu)
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        float value = (float)mantissa / (1 << 24);
+        return sign ? -value : value;
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+// ------------------------------------------------------------------------
+inline int16_t PackSnorm16(float value)
+{
+    return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+inline uint8_t PackUnorm8(float value)
+{
+    return (uint8_t)std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+}
+// GL_INT_2_10_10_10_REV: x in the low bits, w (e.g. tangent handedness) in the top two.
+// GL 4.0 decodes c as (2c + 1) / 1023, so +-1 and 0 are off by at most 1/1023.
+// ------------------------------------------------------------------------
+inline uint32_t PackSnorm1010102(float x, float y, float z, float w)
+{
+    auto component = [](float value, float range, uint32_t mask) -> uint32_t
+    {
+        long c = std::lround(std::min(std::max(value, -1.0f), 1.0f) * range);
+        return (uint32_t)c & mask;
+    };
+    return component(x, 511.0f, 0x3FFu) | (component(y, 511.0f, 0x3FFu) << 10) |
+        (component(z, 511.0f, 0x3FFu) << 20) | (component(w, 1.0f, 0x3u) << 30);
+}
+
+// Per-mesh dequantization: snorm16 positions store (p - offset) / scale, the
+// vertex shader undoes it with ObjectBlock::positionScale/positionOffset.
+// The identity bounds leave float and half positions untouched.
+// ------------------------------------------------------------------------
+struct QuantizationBounds
+{
+    Vec3 offset = Vec3(0.0f, 0.0f, 0.0f);
+    Vec3 scale = Vec3(1.0f, 1.0f, 1.0f);
+
+    // tight bounds for positions stride floats apart
+    static QuantizationBounds fromPositions(const float* positions, unsigned int strideFloats, unsigned int count)
+    {
+        QuantizationBounds bounds;
+        if (count == 0)
+            return bounds;
+        float low[3], high[3];
+        for (int k = 0; k < 3; ++k)
+            low[k] = high[k] = positions[k];
+        for (unsigned int i = 1; i < count; ++i)
+            for (int k = 0; k < 3; ++k)
+            {
+                low[k] = std::min(low[k], positions[(size_t)i * strideFloats + k]);
+                high[k] = std::max(high[k], positions[(size_t)i * strideFloats + k]);
+            }
+        // a flat axis still needs a non-zero scale
+        float half[3];
+        for (int k = 0; k < 3; ++k)
+            half[k] = std::max((high[k] - low[k]) * 0.5f, 1e-6f);
+        bounds.offset = Vec3((low[0] + high[0]) * 0.5f, (low[1] + high[1]) * 0.5f, (low[2] + high[2]) * 0.5f);
+        bounds.scale = Vec3(half[0], half[1], half[2]);
+        return bounds;
+    }
+    // ------------------------------------------------------------------------
+    template <typename VertexT>
+    static QuantizationBounds fromVertices(const std::vector<VertexT>& vertices)
+    {
+        std::vector<float> positions;
+        positions.reserve(vertices.size() * 3);
+        for (const VertexT& vertex : vertices)
+        {
+            positions.push_back(vertex.position.x);
+            positions.push_back(vertex.position.y);
+            positions.push_back(vertex.position.z);
+        }
+        return fromPositions(positions.data(), 3, (unsigned int)vertices.size());
+    }
+    // ------------------------------------------------------------------------
+    Vec3 normalize(const Vec3& p) const
+    {
+        return Vec3((p.x - offset.x) / scale.x, (p.y - offset.y) / scale.y, (p.z - offset.z) / scale.z);
+    }
+};
+
+// ------------------------------------------------------------------------
+enum PositionFormat
+{
+    POSITION_FLOAT,     // 12 bytes
+    POSITION_HALF,      // 8 bytes, +-65504 with 11 significant bits; use for small local-space meshes
+    POSITION_SNORM16,   // 8 bytes, 16 bits across the mesh bounds
+};
+
+// Which attributes a packed vertex has. Locations match VertexShader.shader:
+// 0 position, 1 color (unorm8), 2 normal, 3 tangent (2_10_10_10), 4 uv (half2)
+// ------------------------------------------------------------------------
+struct PackedVertexFormat
+{
+    PositionFormat position = POSITION_SNORM16;
+    bool color = false;
+    bool normal = false;
+    bool tangent = false;
+    bool texCoord = false;
+
+    VertexLayout layout() const
+    {
+        VertexLayout layout;
+        // the 16-bit formats carry a fourth component to keep 4-byte alignment
+        if (position == POSITION_FLOAT)
+            layout.add(0, 3, GL_FLOAT);
+        else if (position == POSITION_HALF)
+            layout.add(0, 4, GL_HALF_FLOAT);
+        else
+            layout.add(0, 4, GL_SHORT, true);
+        if (color)
+            layout.add(1, 4, GL_UNSIGNED_BYTE, true);
+        if (normal)
+            layout.add(2, 4, GL_INT_2_10_10_10_REV, true);
+        if (tangent)
+            layout.add(3, 4, GL_INT_2_10_10_10_REV, true);
+        if (texCoord)
+            layout.add(4, 2, GL_HALF_FLOAT);
+        return layout;
+    }
+};
+
+// Full precision input to VertexPacker
+// ------------------------------------------------------------------------
+struct SourceVertex
+{
+    Vec3 position;
+    Vec4 color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    Vec3 normal = Vec3(0.0f, 0.0f, 1.0f);
+    // w = bitangent sign
+    Vec4 tangent = Vec4(1.0f, 0.0f, 0.0f, 1.0f);
+    float u = 0.0f, v = 0.0f;
+
+    SourceVertex() {}
+    SourceVertex(const Vec3& position, const Vec4& color) : position(position), color(color) {}
+};
+
+// Writes SourceVertex data in a PackedVertexFormat
+// ------------------------------------------------------------------------
+class VertexPacker
+{
+public:
+    VertexPacker(const PackedVertexFormat& format, const QuantizationBounds& bounds = QuantizationBounds())
+        : format(format), layout(format.layout()), bounds(format.position == POSITION_SNORM16 ? bounds : QuantizationBounds())
+    {
+    }
+    // ------------------------------------------------------------------------
+    void pack(const SourceVertex& in, unsigned char* out) const
+    {
+        if (format.position == POSITION_FLOAT)
+        {
+            float p[3] = { in.position.x, in.position.y, in.position.z };
+            out = write(out, p, sizeof(p));
+        }
+        else if (format.position == POSITION_HALF)
+        {
+            uint16_t p[4] = { FloatToHalf(in.position.x), FloatToHalf(in.position.y), FloatToHalf(in.position.z), FloatToHalf(1.0f) };
+            out = write(out, p, sizeof(p));
+        }
+        else
+        {
+            Vec3 n = bounds.normalize(in.position);
+            int16_t p[4] = { PackSnorm16(n.x), PackSnorm16(n.y), PackSnorm16(n.z), 32767 };
+            out = write(out, p, sizeof(p));
+        }
+        if (format.color)
+        {
+            uint8_t c[4] = { PackUnorm8(in.color.x), PackUnorm8(in.color.y), PackUnorm8(in.color.z), PackUnorm8(in.color.w) };
+            out = write(out, c, sizeof(c));
+        }
+        if (format.normal)
+        {
+            Vec3 n = Normalize(in.normal);
+            uint32_t packed = PackSnorm1010102(n.x, n.y, n.z, 0.0f);
+            out = write(out, &packed, sizeof(packed));
+        }
+        if (format.tangent)
+        {
+            Vec3 t = Normalize(Vec3(in.tangent.x, in.tangent.y, in.tangent.z));
+            uint32_t packed = PackSnorm1010102(t.x, t.y, t.z, in.tangent.w < 0.0f ? -1.0f : 1.0f);
+            out = write(out, &packed, sizeof(packed));
+        }
+        if (format.texCoord)
+        {
+            uint16_t uv[2] = { FloatToHalf(in.u), FloatToHalf(in.v) };
+            out = write(out, uv, sizeof(uv));
+        }
+    }
+    // ------------------------------------------------------------------------
+    std::vector<unsigned char> pack(const std::vector<SourceVertex>& vertices) const
+    {
+        std::vector<unsigned char> out((size_t)vertices.size() * layout.getStride());
+        for (size_t i = 0; i < vertices.size(); ++i)
+            pack(vertices[i], &out[i * layout.getStride()]);
+        return out;
+    }
+    // ------------------------------------------------------------------------
+    const VertexLayout& getLayout() const { return layout; }
+    const QuantizationBounds& getBounds() const { return bounds; }
+
+private:
+    PackedVertexFormat format;
+    VertexLayout layout;
+    QuantizationBounds bounds;
+
+    static unsigned char* write(unsigned char* out, const void* data, size_t size)
+    {
+        memcpy(out, data, size);
+        return out + size;
+    }
+};
+#endif